@@ -2,8 +2,11 @@
 
 #include <QMap>
 #include <QList>
+#include <QIODevice>
 #include <QDebug>
 
+#include <string.h>
+
 /**
  * (copied from http://tnetstrings.org)
  *
@@ -83,6 +86,7 @@
 using namespace QTNetString;
 
 /* neccessary prototypes */
+static QByteArray dump_value(const QVariant &value, bool canonical, bool &ok);
 QVariant parse_payload(const QByteArray &payload, int sub_start_pos, int sub_end_pos,
             int &tns_end_pos, bool &ok);
 
@@ -133,12 +137,22 @@ dump_string(const QVariant &value, QByteArray & tns_value, TnsType & tns_type, b
 }
 
 
+/**
+ * canonical floats are always written with 17 significant digits,
+ * which is enough to restore every double exactly
+ */
 inline void
-dump_float(const QVariant &value, QByteArray & tns_value, TnsType & tns_type, bool &ok)
+dump_float(const QVariant &value, QByteArray & tns_value, TnsType & tns_type, bool canonical,
+            bool &ok)
 {
     ok = value.canConvert(QVariant::ByteArray);
     if (ok) {
-        tns_value = value.toByteArray();
+        if (canonical) {
+            tns_value = QByteArray::number(value.toDouble(), 'g', 17);
+        }
+        else {
+            tns_value = value.toByteArray();
+        }
         tns_type = TNS_FLOAT;
     }
 }
@@ -159,29 +173,48 @@ dump_bool(const QVariant &value, QByteArray & tns_value, TnsType & tns_type, boo
 }
 
 
+/**
+ * canonical maps are sorted by the bytes of their dumped keys
+ * instead of the QString order of QMap
+ */
 inline void
-dump_map(const QVariant &value, QByteArray & tns_value, TnsType & tns_type, bool &ok)
+dump_map(const QVariant &value, QByteArray & tns_value, TnsType & tns_type, bool canonical,
+            bool &ok)
 {
     ok = value.canConvert(QVariant::Map);
     if (ok) {
+        QMap<QByteArray, QByteArray> sorted_entries;
         QMap<QString, QVariant> map_value = value.toMap();
         QMap<QString, QVariant>::const_iterator iter = map_value.constBegin();
         while (iter != map_value.constEnd() && ok ) {
             QString key_str = iter.key();
             QVariant key(key_str);
-            tns_value.append(dump(key, ok));
+            QByteArray entry = dump_value(key, canonical, ok);
             if (ok) {
-                tns_value.append(dump(iter.value(), ok));
+                entry.append(dump_value(iter.value(), canonical, ok));
+            }
+            if (canonical) {
+                sorted_entries.insert(key.toByteArray(), entry);
+            }
+            else {
+                tns_value.append(entry);
             }
             ++iter;
         }
+
+        QMap<QByteArray, QByteArray>::const_iterator entry_iter = sorted_entries.constBegin();
+        while (entry_iter != sorted_entries.constEnd() && ok) {
+            tns_value.append(entry_iter.value());
+            ++entry_iter;
+        }
         tns_type = TNS_MAP;
     }
 }
 
 
 inline void
-dump_list(const QVariant &value, QByteArray & tns_value, TnsType & tns_type, bool &ok)
+dump_list(const QVariant &value, QByteArray & tns_value, TnsType & tns_type, bool canonical,
+            bool &ok)
 {
     ok = value.canConvert(QVariant::List);
     if (ok) {
@@ -189,7 +222,7 @@ dump_list(const QVariant &value, QByteArray & tns_value, TnsType & tns_type, boo
         QList<QVariant>::const_iterator iter = list_value.constBegin();
         while (iter != list_value.constEnd() && ok ) {
             QVariant key(*iter);
-            tns_value.append(dump(key, ok));
+            tns_value.append(dump_value(key, canonical, ok));
             ++iter;
         }
         tns_type = TNS_LIST;
@@ -221,14 +254,28 @@ dump_unknown(const QVariant &value, QByteArray & tns_value, TnsType & tns_type,
 
 
 
-QByteArray
-QTNetString::dump(const QVariant &value, bool &ok)
+static QByteArray
+dump_value(const QVariant &value, bool canonical, bool &ok)
 {
     QByteArray tns;
     QByteArray tns_value;
     TnsType tns_type = TNS_NULL;
     ok = true;
 
+    if (value.userType() == qMetaTypeId<PreEncoded>()) {
+        tns = value.value<PreEncoded>().tns();
+        if (tns.isEmpty()) {
+            qDebug() << "pre-encoded value is empty";
+            ok = false;
+        }
+        else if (canonical) {
+            // the bytes do not have to be canonical, encode them again
+            QVariant decoded = parse(tns, ok);
+            tns = ok ? dump_value(decoded, true, ok) : QByteArray();
+        }
+        return tns;
+    }
+
     if (!value.isNull()) {
         switch(value.type()) {
             case QVariant::Int:
@@ -245,23 +292,28 @@ QTNetString::dump(const QVariant &value, bool &ok)
                 dump_string(value, tns_value, tns_type, ok);
                 break;
             case QVariant::Double:
-                dump_float(value, tns_value, tns_type, ok);
+                dump_float(value, tns_value, tns_type, canonical, ok);
                 break;
             case QVariant::Bool:
                 dump_bool(value, tns_value, tns_type, ok);
                 break;
             case QVariant::List:
-                dump_list(value, tns_value, tns_type, ok);
+                dump_list(value, tns_value, tns_type, canonical, ok);
                 break;
             case QVariant::Map:
             case QVariant::Hash:
-                dump_map(value, tns_value, tns_type, ok);
+                dump_map(value, tns_value, tns_type, canonical, ok);
                 break;
             default:
                 dump_unknown(value, tns_value, tns_type, ok);
         }
     }
 
+    if (ok && (tns_value.size() > TNS_MAX_SIZE)) {
+        qDebug() << "tns payload is too large: " << tns_value.size();
+        ok = false;
+    }
+
     if (ok) {
         tns.append(QByteArray::number(tns_value.size()));
         tns.append(':');
@@ -273,6 +325,204 @@ QTNetString::dump(const QVariant &value, bool &ok)
 }
 
 
+QByteArray
+QTNetString::dump(const QVariant &value, bool &ok)
+{
+    return dump_value(value, false, ok);
+}
+
+
+bool
+QTNetString::isContainer(const QVariant &value)
+{
+    if (value.isNull() || (value.userType() == qMetaTypeId<PreEncoded>())) {
+        return false;
+    }
+    return (value.type() == QVariant::List) || (value.type() == QVariant::Map)
+            || (value.type() == QVariant::Hash);
+}
+
+
+/**
+ * the prefix written before the payload of a container and
+ * overwritten once its size is known
+ */
+static const char TNS_PLACEHOLDER[] = "000000000:";
+
+
+/**
+ * the size prefix for a payload of pl_size bytes, padded to
+ * the length of the placeholder
+ */
+static QByteArray
+padded_size(int pl_size, bool &ok)
+{
+    if (pl_size > TNS_MAX_SIZE) {
+        qDebug() << "tns payload is too large: " << pl_size;
+        ok = false;
+        return QByteArray();
+    }
+    return QByteArray::number(pl_size).rightJustified(TNS_MAX_SIZE_DIGITS, '0');
+}
+
+
+static void
+dump_padded(const QVariant &value, QByteArray &out, bool &ok)
+{
+    if (!isContainer(value)) {
+        out.append(dump_value(value, false, ok));
+        return;
+    }
+
+    int pl_start = out.size() + TNS_MAX_SIZE_DIGITS + 1;
+    out.append(TNS_PLACEHOLDER);
+
+    char tns_type;
+    if (value.type() == QVariant::List) {
+        QList<QVariant> list_value = value.toList();
+        for (int i = 0; ok && (i < list_value.size()); ++i) {
+            dump_padded(list_value.at(i), out, ok);
+        }
+        tns_type = TNS_LIST;
+    }
+    else {
+        QMap<QString, QVariant> map_value = value.toMap();
+        QMap<QString, QVariant>::const_iterator iter = map_value.constBegin();
+        for (; ok && (iter != map_value.constEnd()); ++iter) {
+            out.append(dump_value(QVariant(iter.key()), false, ok));
+            if (ok) {
+                dump_padded(iter.value(), out, ok);
+            }
+        }
+        tns_type = TNS_MAP;
+    }
+
+    QByteArray size = ok ? padded_size(out.size() - pl_start, ok) : QByteArray();
+    if (ok) {
+        memcpy(out.data() + pl_start - TNS_MAX_SIZE_DIGITS - 1, size.constData(),
+                TNS_MAX_SIZE_DIGITS);
+        out.append(tns_type);
+    }
+}
+
+
+static void
+dump_padded(const QVariant &value, QIODevice *device, bool &ok)
+{
+    if (!isContainer(value)) {
+        QByteArray tns = dump_value(value, false, ok);
+        ok = ok && (device->write(tns) == tns.size());
+        return;
+    }
+
+    qint64 prefix_pos = device->pos();
+    ok = device->write(TNS_PLACEHOLDER, TNS_MAX_SIZE_DIGITS + 1) == (TNS_MAX_SIZE_DIGITS + 1);
+
+    char tns_type;
+    if (value.type() == QVariant::List) {
+        QList<QVariant> list_value = value.toList();
+        for (int i = 0; ok && (i < list_value.size()); ++i) {
+            dump_padded(list_value.at(i), device, ok);
+        }
+        tns_type = TNS_LIST;
+    }
+    else {
+        QMap<QString, QVariant> map_value = value.toMap();
+        QMap<QString, QVariant>::const_iterator iter = map_value.constBegin();
+        for (; ok && (iter != map_value.constEnd()); ++iter) {
+            QByteArray key = dump_value(QVariant(iter.key()), false, ok);
+            ok = ok && (device->write(key) == key.size());
+            if (ok) {
+                dump_padded(iter.value(), device, ok);
+            }
+        }
+        tns_type = TNS_MAP;
+    }
+
+    qint64 end_pos = device->pos();
+    qint64 pl_size = end_pos - prefix_pos - TNS_MAX_SIZE_DIGITS - 1;
+    QByteArray size = ok ? padded_size(int(qMin(pl_size, qint64(TNS_MAX_SIZE) + 1)), ok)
+                : QByteArray();
+    ok = ok && device->seek(prefix_pos) && (device->write(size) == size.size())
+            && device->seek(end_pos) && device->putChar(tns_type);
+}
+
+
+QByteArray
+QTNetString::dumpPadded(const QVariant &value, bool &ok)
+{
+    QByteArray tns;
+    ok = true;
+    dump_padded(value, tns, ok);
+    if (!ok) {
+        tns.clear();
+    }
+    return tns;
+}
+
+
+void
+QTNetString::dumpPadded(const QVariant &value, QIODevice *device, bool &ok)
+{
+    if (device->isSequential()) {
+        qDebug() << "padded dump needs a random access device";
+        ok = false;
+        return;
+    }
+
+    ok = true;
+    dump_padded(value, device, ok);
+    if (!ok) {
+        qDebug() << "could not write padded tns to device";
+    }
+}
+
+
+QByteArray
+QTNetString::dumpCanonical(const QVariant &value, bool &ok)
+{
+    return dump_value(value, true, ok);
+}
+
+
+QByteArray
+QTNetString::dumpCanonical(const QVariant &value, quint64 &digest, bool &ok)
+{
+    QByteArray tns = dump_value(value, true, ok);
+    digest = hash(tns.constData(), tns.size());
+    return tns;
+}
+
+
+PreEncoded::PreEncoded()
+{
+}
+
+
+PreEncoded::PreEncoded(const QByteArray &tns)
+    : m_tns(tns)
+{
+}
+
+
+QByteArray
+PreEncoded::tns() const
+{
+    return m_tns;
+}
+
+
+QVariant
+QTNetString::preEncode(const QVariant &value, bool &ok)
+{
+    QByteArray tns = dump(value, ok);
+    if (!ok) {
+        return QVariant();
+    }
+    return QVariant::fromValue(PreEncoded(tns));
+}
+
+
 inline void
 parse_bool(const QByteArray &payload, QVariant &value, int pl_start, int pl_size)
 {
@@ -428,19 +678,20 @@ parse_payload(const QByteArray &payload, int sub_start_pos, int sub_end_pos,
     // convert the size to int;
     QByteArray ba_size = payload.mid(sub_start_pos, colon_pos-sub_start_pos);
     int pl_size = ba_size.toInt(&ok);
-    if (!ok) {
+    if (!ok || (pl_size < 0) || (ba_size.size() > TNS_MAX_SIZE_DIGITS)) {
         qDebug() << "invalid tns size: " << ba_size;
         ok = false;
         return value;
     }
 
+    // the sum may not fit into an int for payloads close to 2 GB
     int pl_start = colon_pos + 1;
-    int pl_end = pl_start + pl_size - 1;
-    if (pl_end >= sub_end_pos) {
+    if ((qint64(pl_start) + pl_size - 1) >= sub_end_pos) {
         qDebug() << "tns specifies no type";
         ok = false;
         return value;
     }
+    int pl_end = pl_start + pl_size - 1;
 
     switch (payload.at(pl_end + 1)) {
         case TNS_NULL:
@@ -510,3 +761,288 @@ QTNetString::parse(const QByteArray &tnetstring, bool &ok)
 
     return parse(tnetstring, 0, tns_end_pos, ok);
 }
+
+
+bool
+QTNetString::frame(const char *data, qint64 data_size, qint64 tns_start_pos,
+            qint64 &tns_end_pos, bool &ok)
+{
+    ok = true;
+
+    qint64 pos = tns_start_pos;
+    qint64 pl_size = 0;
+
+    while ((pos < data_size) && (data[pos] >= '0') && (data[pos] <= '9')) {
+        if ((pos - tns_start_pos) >= TNS_MAX_SIZE_DIGITS) {
+            qDebug() << "tns size has too many digits";
+            ok = false;
+            return false;
+        }
+        pl_size = (pl_size * 10) + (data[pos] - '0');
+        ++pos;
+    }
+
+    if (pos >= data_size) {
+        // size prefix is not complete yet
+        return false;
+    }
+
+    if ((pos == tns_start_pos) || (data[pos] != ':')) {
+        qDebug() << "no seperating colon found";
+        ok = false;
+        return false;
+    }
+
+    // pl_size has at most 9 digits, so this can not overflow as
+    // long as pos is a valid position
+    qint64 type_pos = pos + 1 + pl_size;
+    if (type_pos >= data_size) {
+        return false;
+    }
+
+    switch (data[type_pos]) {
+        case TNS_NULL:
+        case TNS_STRING:
+        case TNS_BOOL:
+        case TNS_INT:
+        case TNS_FLOAT:
+        case TNS_MAP:
+        case TNS_LIST:
+            break;
+        default:
+            qDebug() << "unknown tns type: " << data[type_pos];
+            ok = false;
+            return false;
+    }
+
+    tns_end_pos = type_pos + 1;
+    return true;
+}
+
+
+bool
+QTNetString::frame(const QByteArray &tnetstring, int tns_start_pos, int &tns_end_pos,
+            bool &ok)
+{
+    qint64 end_pos;
+    if (!frame(tnetstring.constData(), tnetstring.size(), tns_start_pos, end_pos, ok)) {
+        return false;
+    }
+
+    tns_end_pos = int(end_pos);
+    return true;
+}
+
+
+bool
+QTNetString::elementAt(const QByteArray &tnetstring, int tns_start_pos, int limit,
+            Element &element, bool &ok)
+{
+    if (!frame(tnetstring, tns_start_pos, element.end, ok) || (element.end > limit)) {
+        qDebug() << "tns exceeds its container";
+        ok = false;
+        return false;
+    }
+
+    element.start = tns_start_pos;
+    element.pl_start = tnetstring.indexOf(':', tns_start_pos) + 1;
+    element.pl_end = element.end - 1;
+    element.type = tnetstring.at(element.pl_end);
+    return true;
+}
+
+
+bool
+QTNetString::findChild(const QByteArray &tnetstring, const Element &parent,
+            const QByteArray &component, Element &child, bool &ok)
+{
+    int pos = parent.pl_start;
+    ok = true;
+
+    if (parent.type == TNS_LIST) {
+        bool is_index;
+        int index = component.toInt(&is_index);
+        if (!is_index || (index < 0)) {
+            return false;
+        }
+        while (ok && (pos < parent.pl_end)
+                    && elementAt(tnetstring, pos, parent.pl_end, child, ok)) {
+            if (index-- == 0) {
+                return true;
+            }
+            pos = child.end;
+        }
+    }
+    else if (parent.type == TNS_MAP) {
+        Element key;
+        while (ok && (pos < parent.pl_end)
+                    && elementAt(tnetstring, pos, parent.pl_end, key, ok)
+                    && elementAt(tnetstring, key.end, parent.pl_end, child, ok)) {
+            int key_size = key.pl_end - key.pl_start;
+            if ((key_size == component.size())
+                        && (memcmp(tnetstring.constData() + key.pl_start, component.constData(),
+                                key_size) == 0)) {
+                return true;
+            }
+            pos = child.end;
+        }
+    }
+    return false;
+}
+
+
+QVariant
+QTNetString::parse(const char *data, qint64 data_size, qint64 tns_start_pos,
+            qint64 &tns_end_pos, bool &ok)
+{
+    QVariant value;
+
+    if (!frame(data, data_size, tns_start_pos, tns_end_pos, ok)) {
+        if (ok) {
+            qDebug() << "tns is not complete";
+            ok = false;
+        }
+        return value;
+    }
+
+    // a single tns is never larger than 1 GB, so it can always
+    // be wrapped into a QByteArray without copying it
+    QByteArray tns = QByteArray::fromRawData(data + tns_start_pos,
+                int(tns_end_pos - tns_start_pos));
+    return parse(tns, ok);
+}
+
+
+QList<qint64>
+QTNetString::splitRecords(const char *data, qint64 data_size, int parts)
+{
+    QList<qint64> positions;
+    qint64 part_size = (data_size / qMax(parts, 1)) + 1;
+    qint64 next_split = part_size;
+    qint64 pos = 0;
+    bool ok = true;
+
+    positions.append(0);
+    while ((parts > 1) && (pos < data_size)) {
+        qint64 tns_end_pos;
+        if (!frame(data, data_size, pos, tns_end_pos, ok)) {
+            break;
+        }
+        if ((tns_end_pos >= next_split) && (tns_end_pos < data_size)) {
+            positions.append(tns_end_pos);
+            next_split = tns_end_pos + part_size;
+        }
+        pos = tns_end_pos;
+    }
+    positions.append(data_size);
+    return positions;
+}
+
+/*
+ * xxHash64, see https://github.com/Cyan4973/xxHash
+ */
+static const quint64 XXH_PRIME64_1 = Q_UINT64_C(0x9E3779B185EBCA87);
+static const quint64 XXH_PRIME64_2 = Q_UINT64_C(0xC2B2AE3D27D4EB4F);
+static const quint64 XXH_PRIME64_3 = Q_UINT64_C(0x165667B19E3779F9);
+static const quint64 XXH_PRIME64_4 = Q_UINT64_C(0x85EBCA77C2B2AE63);
+static const quint64 XXH_PRIME64_5 = Q_UINT64_C(0x27D4EB2F165667C5);
+
+
+inline quint64
+xxh_rotl(quint64 value, int bits)
+{
+    return (value << bits) | (value >> (64 - bits));
+}
+
+
+inline quint64
+xxh_read64(const uchar *p)
+{
+    return quint64(p[0]) | (quint64(p[1]) << 8) | (quint64(p[2]) << 16)
+            | (quint64(p[3]) << 24) | (quint64(p[4]) << 32) | (quint64(p[5]) << 40)
+            | (quint64(p[6]) << 48) | (quint64(p[7]) << 56);
+}
+
+
+inline quint64
+xxh_read32(const uchar *p)
+{
+    return quint64(p[0]) | (quint64(p[1]) << 8) | (quint64(p[2]) << 16)
+            | (quint64(p[3]) << 24);
+}
+
+
+inline quint64
+xxh_round(quint64 acc, quint64 input)
+{
+    acc += input * XXH_PRIME64_2;
+    acc = xxh_rotl(acc, 31);
+    return acc * XXH_PRIME64_1;
+}
+
+
+inline quint64
+xxh_merge_round(quint64 acc, quint64 value)
+{
+    acc ^= xxh_round(0, value);
+    return acc * XXH_PRIME64_1 + XXH_PRIME64_4;
+}
+
+
+quint64
+QTNetString::hash(const char *data, qint64 size, quint64 seed)
+{
+    const uchar *p = reinterpret_cast<const uchar *>(data);
+    const uchar *end = p + size;
+    quint64 h;
+
+    if (size >= 32) {
+        quint64 v1 = seed + XXH_PRIME64_1 + XXH_PRIME64_2;
+        quint64 v2 = seed + XXH_PRIME64_2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - XXH_PRIME64_1;
+
+        const uchar *limit = end - 32;
+        do {
+            v1 = xxh_round(v1, xxh_read64(p));
+            v2 = xxh_round(v2, xxh_read64(p + 8));
+            v3 = xxh_round(v3, xxh_read64(p + 16));
+            v4 = xxh_round(v4, xxh_read64(p + 24));
+            p += 32;
+        } while (p <= limit);
+
+        h = xxh_rotl(v1, 1) + xxh_rotl(v2, 7) + xxh_rotl(v3, 12) + xxh_rotl(v4, 18);
+        h = xxh_merge_round(h, v1);
+        h = xxh_merge_round(h, v2);
+        h = xxh_merge_round(h, v3);
+        h = xxh_merge_round(h, v4);
+    }
+    else {
+        h = seed + XXH_PRIME64_5;
+    }
+
+    h += quint64(size);
+
+    while ((end - p) >= 8) {
+        h ^= xxh_round(0, xxh_read64(p));
+        h = xxh_rotl(h, 27) * XXH_PRIME64_1 + XXH_PRIME64_4;
+        p += 8;
+    }
+    if ((end - p) >= 4) {
+        h ^= xxh_read32(p) * XXH_PRIME64_1;
+        h = xxh_rotl(h, 23) * XXH_PRIME64_2 + XXH_PRIME64_3;
+        p += 4;
+    }
+    while (p < end) {
+        h ^= (*p) * XXH_PRIME64_5;
+        h = xxh_rotl(h, 11) * XXH_PRIME64_1;
+        ++p;
+    }
+
+    h ^= h >> 33;
+    h *= XXH_PRIME64_2;
+    h ^= h >> 29;
+    h *= XXH_PRIME64_3;
+    h ^= h >> 32;
+    return h;
+}
@@ -4,6 +4,11 @@
 
 #include "QByteArray"
 #include "QVariant"
+#include "QMetaType"
+#include "QList"
+
+
+class QIODevice;
 
 
 /**
@@ -14,6 +19,13 @@
  */
 namespace QTNetString {
 
+    /**
+     * the longest size prefix the grammar allows and the largest
+     * payload size it can hold
+     */
+    const int TNS_MAX_SIZE_DIGITS = 9;
+    const int TNS_MAX_SIZE = 999999999;
+
     /**
      * Dump the contents of a QVariant structure into
      * a QByteArray.
@@ -24,10 +36,52 @@ namespace QTNetString {
      * string types.
      *
      * sets ok to false in case of an error and return
-     * a empty QByteArray.
+     * a empty QByteArray. This includes values whose payload would
+     * not fit into the 9 digits of the size prefix.
      */
     QByteArray dump(const QVariant &value, bool &ok);
 
+    /**
+     * the same as the dump method, but the output only depends on
+     * the logical value: map entries are sorted by the bytes of their
+     * keys, no matter if the value was a QMap or a QHash, and floats
+     * are always written with 17 significant digits.
+     *
+     * Equal values always produce equal bytes, so the result can be
+     * used to detect duplicates. PreEncoded values are parsed and
+     * encoded again, their bytes are not copied.
+     */
+    QByteArray dumpCanonical(const QVariant &value, bool &ok);
+
+    /**
+     * the same as dumpCanonical, and writes the hash of the
+     * result to digest.
+     */
+    QByteArray dumpCanonical(const QVariant &value, quint64 &digest, bool &ok);
+
+    /**
+     * the same as the dump method, but encodes the value in a single
+     * pass without copying the payloads of containers.
+     *
+     * Lists and maps get a size prefix with all 9 digits the grammar
+     * allows, e.g. "000000042:", which is written as a placeholder
+     * and filled in when the container is complete. Every container
+     * costs a few bytes more than with dump.
+     */
+    QByteArray dumpPadded(const QVariant &value, bool &ok);
+
+    /**
+     * the same as dumpPadded, writing directly to device. The device
+     * has to be random access, like a QFile or a QBuffer, as the size
+     * prefixes are written after the payloads.
+     */
+    void dumpPadded(const QVariant &value, QIODevice *device, bool &ok);
+
+    /**
+     * 64 bit xxHash (XXH64) of the given data.
+     */
+    quint64 hash(const char *data, qint64 size, quint64 seed = 0);
+
     /**
      * Parse the contents of the given TNetString and
      * return its contents as a QVariant structure.
@@ -50,7 +104,125 @@ namespace QTNetString {
      */
     QVariant parse(const QByteArray &tnetstring, int tns_start_pos, int &tns_end_pos, bool &ok);
 
+    /**
+     * Find the end of the tns starting at tns_start_pos by only
+     * looking at its size prefix. The payload is not parsed.
+     *
+     * returns true if the tnetstring contains the complete tns and
+     * writes the position right after its type character to
+     * tns_end_pos.
+     *
+     * returns false if the tns is not complete yet. ok is set to false
+     * if the data at tns_start_pos can not be the beginning of a tns.
+     */
+    bool frame(const QByteArray &tnetstring, int tns_start_pos, int &tns_end_pos, bool &ok);
+
+    /**
+     * Positions of a tns inside of a QByteArray as found by elementAt.
+     * pl_start is the first byte of the payload, pl_end the position
+     * of the type character and end the position right after it.
+     */
+    struct Element {
+        int start;
+        int pl_start;
+        int pl_end;
+        int end;
+        char type;
+    };
+
+    /**
+     * Find the positions of the tns starting at tns_start_pos, which
+     * has to end before limit, e.g. the end of its container.
+     *
+     * returns false and sets ok to false if there is no complete
+     * tns within these bounds.
+     */
+    bool elementAt(const QByteArray &tnetstring, int tns_start_pos, int limit,
+                Element &element, bool &ok);
+
+    /**
+     * Find the child of the list or map element parent named by
+     * component, which is the decimal index for lists and the key
+     * for maps. For maps child is the value of the entry.
+     *
+     * returns false if there is no such child, ok is set to false
+     * if the tnetstring is not valid.
+     */
+    bool findChild(const QByteArray &tnetstring, const Element &parent,
+                const QByteArray &component, Element &child, bool &ok);
+
+    /**
+     * the same as the frame method above, but for data which is not
+     * held in a QByteArray, like memory mapped files. Positions are
+     * 64 bit, so data may be larger than 2 GB.
+     */
+    bool frame(const char *data, qint64 data_size, qint64 tns_start_pos,
+                qint64 &tns_end_pos, bool &ok);
+
+    /**
+     * parse the tns at tns_start_pos of data without copying it.
+     *
+     * Positions are 64 bit, so data may be larger than 2 GB. A single
+     * tns is limited to 9 digits of size by the grammar and always
+     * fits into a QByteArray.
+     *
+     * the position right after the tns will be written to the
+     * tns_end_pos parameter
+     */
+    QVariant parse(const char *data, qint64 data_size, qint64 tns_start_pos,
+                qint64 &tns_end_pos, bool &ok);
+
+    /**
+     * split the concatenated tns records in data into about parts
+     * pieces of equal size, e.g. to process them on several threads.
+     *
+     * returns the positions where the pieces start, followed by
+     * data_size. Only the size prefixes are read; when data contains
+     * something which is not a tns the rest of data is left in the
+     * last piece, so the error is found when it is processed.
+     */
+    QList<qint64> splitRecords(const char *data, qint64 data_size, int parts);
+
+    /**
+     * A value which has been dumped already.
+     *
+     * When dump finds a PreEncoded inside of a QVariant structure it
+     * copies its bytes into the output instead of encoding the value
+     * again. This is meant for large parts of messages which do not
+     * change between dumps. dumpCanonical does not copy them, it
+     * parses and encodes them again to normalize them.
+     *
+     * The bytes are not checked, they have to be a complete tns.
+     */
+    class PreEncoded {
+    public:
+        PreEncoded();
+        explicit PreEncoded(const QByteArray &tns);
+
+        QByteArray tns() const;
+
+    private:
+        QByteArray m_tns;
+    };
+
+    /**
+     * dump value and return the result as a PreEncoded wrapped in a
+     * QVariant, ready to be put into other QVariant structures.
+     *
+     * sets ok to false in case of an error and returns
+     * QVariant::Invalid.
+     */
+    QVariant preEncode(const QVariant &value, bool &ok);
+
+    /**
+     * true for the lists, maps and hashes dump encodes element by
+     * element. Null values and PreEncoded values are no containers.
+     */
+    bool isContainer(const QVariant &value);
+
 }
 
+Q_DECLARE_METATYPE(QTNetString::PreEncoded)
+
 
 #endif
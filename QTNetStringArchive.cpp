@@ -0,0 +1,418 @@
+#include "QTNetStringArchive.h"
+#include "QTNetString.h"
+
+#include <QIODevice>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+
+using namespace QTNetString;
+
+static const char ARCHIVE_CODEC[] = "zlib";
+/* "20:" + 20 digits + "#" */
+static const int ARCHIVE_FOOTER_SIZE = 24;
+
+
+/**
+ * the value of an integer element. Offsets in archives may be
+ * larger than the int parse() returns.
+ */
+static qint64
+element_integer(const QByteArray &tnetstring, const Element &element, bool &ok)
+{
+    if (element.type != '#') {
+        ok = false;
+        return 0;
+    }
+    return tnetstring.mid(element.pl_start, element.pl_end - element.pl_start).toLongLong(&ok);
+}
+
+
+ArchiveWriter::ArchiveWriter(QIODevice *device, int block_size, int level)
+    : m_device(device), m_block_size(block_size), m_level(level), m_pos(0),
+      m_record_count(0), m_finished(false)
+{
+}
+
+
+ArchiveWriter::~ArchiveWriter()
+{
+    finish();
+}
+
+
+void
+ArchiveWriter::write(const QVariant &value, bool &ok)
+{
+    QByteArray tns = dump(value, ok);
+    if (ok) {
+        writeTns(tns, ok);
+    }
+}
+
+
+void
+ArchiveWriter::writeTns(const QByteArray &tns, bool &ok)
+{
+    if (m_finished) {
+        qDebug() << "archive is finished already";
+        ok = false;
+        return;
+    }
+
+    m_records.append(tns);
+    ++m_record_count;
+
+    ok = (m_records.size() < m_block_size) || write_block();
+}
+
+
+bool
+ArchiveWriter::write_block()
+{
+    if (m_record_count == 0) {
+        return true;
+    }
+
+    QByteArray compressed = qCompress(m_records, m_level);
+    m_records.clear();
+
+    QList<QVariant> block;
+    block.append(QByteArray(ARCHIVE_CODEC));
+    block.append(m_record_count);
+    block.append(compressed);
+
+    bool ok;
+    QByteArray tns = dump(QVariant(block), ok);
+    if (!ok || (m_device->write(tns) != tns.size())) {
+        qDebug() << "could not write archive block";
+        m_record_count = 0;
+        return false;
+    }
+
+    QList<QVariant> entry;
+    entry.append(m_pos);
+    entry.append(tns.size());
+    entry.append(m_record_count);
+    m_index.append(QVariant(entry));
+
+    m_pos += tns.size();
+    m_record_count = 0;
+    return true;
+}
+
+
+bool
+ArchiveWriter::finish()
+{
+    if (m_finished) {
+        return true;
+    }
+    m_finished = true;
+
+    bool ok = write_block();
+    QByteArray index;
+    if (ok) {
+        index = dump(QVariant(m_index), ok);
+    }
+    if (!ok || (m_device->write(index) != index.size())) {
+        qDebug() << "could not write archive index";
+        return false;
+    }
+
+    QByteArray footer = "20:" + QByteArray::number(m_pos).rightJustified(20, '0') + "#";
+    return m_device->write(footer) == footer.size();
+}
+
+
+ArchiveReader::ArchiveReader(QIODevice *device, int max_in_flight)
+    : m_device(device),
+      m_max_in_flight((max_in_flight > 0) ? max_in_flight : QThread::idealThreadCount()),
+      m_next_block(0), m_read_failed(false), m_current_pos(0), m_cached_index(-1)
+{
+}
+
+
+ArchiveReader::~ArchiveReader()
+{
+    while (!m_in_flight.isEmpty()) {
+        m_in_flight.dequeue().waitForFinished();
+    }
+}
+
+
+bool
+ArchiveReader::open()
+{
+    qint64 size = m_device->size();
+    bool ok = (size >= ARCHIVE_FOOTER_SIZE) && m_device->seek(size - ARCHIVE_FOOTER_SIZE);
+    QByteArray footer = ok ? m_device->read(ARCHIVE_FOOTER_SIZE) : QByteArray();
+
+    Element element;
+    qint64 index_pos = -1;
+    if (ok && elementAt(footer, 0, footer.size(), element, ok)) {
+        index_pos = element_integer(footer, element, ok);
+    }
+    if (!ok || (index_pos < 0) || (index_pos > (size - ARCHIVE_FOOTER_SIZE))
+                || !m_device->seek(index_pos)) {
+        qDebug() << "device does not contain an archive";
+        return false;
+    }
+
+    QByteArray index = m_device->read(size - ARCHIVE_FOOTER_SIZE - index_pos);
+    Element list;
+    if (!elementAt(index, 0, index.size(), list, ok) || (list.type != ']')) {
+        qDebug() << "invalid archive index";
+        return false;
+    }
+
+    m_blocks.clear();
+    qint64 first_record = 0;
+    int pos = list.pl_start;
+    while (ok && (pos < list.pl_end)) {
+        Element entry;
+        Element offset;
+        Element block_size;
+        Element records;
+        ok = elementAt(index, pos, list.pl_end, entry, ok)
+                    && elementAt(index, entry.pl_start, entry.pl_end, offset, ok)
+                    && elementAt(index, offset.end, entry.pl_end, block_size, ok)
+                    && elementAt(index, block_size.end, entry.pl_end, records, ok);
+        if (!ok) {
+            break;
+        }
+
+        BlockInfo info;
+        info.offset = element_integer(index, offset, ok);
+        info.size = int(element_integer(index, block_size, ok));
+        info.records = int(element_integer(index, records, ok));
+        info.first_record = first_record;
+        first_record += info.records;
+        m_blocks.append(info);
+        pos = entry.end;
+    }
+
+    if (!ok) {
+        qDebug() << "invalid archive index";
+        m_blocks.clear();
+        return false;
+    }
+    return true;
+}
+
+
+int
+ArchiveReader::blockCount() const
+{
+    return m_blocks.size();
+}
+
+
+qint64
+ArchiveReader::recordCount() const
+{
+    if (m_blocks.isEmpty()) {
+        return 0;
+    }
+    return m_blocks.last().first_record + m_blocks.last().records;
+}
+
+
+ArchiveReader::Result
+ArchiveReader::decompress(const QByteArray &block)
+{
+    Result result;
+    Element list;
+    Element codec;
+    Element records;
+    Element data;
+
+    if (!elementAt(block, 0, block.size(), list, result.ok) || (list.type != ']')
+                || !elementAt(block, list.pl_start, list.pl_end, codec, result.ok)
+                || !elementAt(block, codec.end, list.pl_end, records, result.ok)
+                || !elementAt(block, records.end, list.pl_end, data, result.ok)
+                || (data.type != ',')) {
+        qDebug() << "invalid archive block";
+        result.ok = false;
+        return result;
+    }
+
+    if (block.mid(codec.pl_start, codec.pl_end - codec.pl_start) != ARCHIVE_CODEC) {
+        qDebug() << "unknown archive codec";
+        result.ok = false;
+        return result;
+    }
+
+    int size = data.pl_end - data.pl_start;
+    result.records = qUncompress(reinterpret_cast<const uchar *>(block.constData())
+                + data.pl_start, size);
+    result.ok = (size == 0) || !result.records.isEmpty();
+    if (!result.ok) {
+        qDebug() << "could not decompress archive block";
+    }
+    return result;
+}
+
+
+bool
+ArchiveReader::read_raw(int index, QByteArray &raw)
+{
+    const BlockInfo &info = m_blocks.at(index);
+    if (!m_device->seek(info.offset)) {
+        qDebug() << "could not seek to archive block";
+        return false;
+    }
+
+    raw = m_device->read(info.size);
+    if (raw.size() != info.size) {
+        qDebug() << "archive block is truncated";
+        return false;
+    }
+    return true;
+}
+
+
+QByteArray
+ArchiveReader::block(int index, bool &ok)
+{
+    if ((index < 0) || (index >= m_blocks.size())) {
+        qDebug() << "archive block index out of range";
+        ok = false;
+        return QByteArray();
+    }
+
+    if (index == m_cached_index) {
+        ok = true;
+        return m_cached;
+    }
+
+    QByteArray raw;
+    ok = read_raw(index, raw);
+    if (!ok) {
+        return QByteArray();
+    }
+
+    Result result = decompress(raw);
+    ok = result.ok;
+    if (ok) {
+        m_cached_index = index;
+        m_cached = result.records;
+    }
+    return result.records;
+}
+
+
+QVariant
+ArchiveReader::record(qint64 index, bool &ok)
+{
+    // binary search for the block containing the record
+    int low = 0;
+    int high = m_blocks.size() - 1;
+    while (low < high) {
+        int middle = (low + high + 1) / 2;
+        if (m_blocks.at(middle).first_record <= index) {
+            low = middle;
+        }
+        else {
+            high = middle - 1;
+        }
+    }
+
+    if ((index < 0) || (index >= recordCount())) {
+        qDebug() << "archive record index out of range";
+        ok = false;
+        return QVariant();
+    }
+
+    QByteArray records = block(low, ok);
+    qint64 pos = 0;
+    for (qint64 skip = index - m_blocks.at(low).first_record; ok && (skip > 0); --skip) {
+        qint64 tns_end_pos;
+        if (!frame(records.constData(), records.size(), pos, tns_end_pos, ok)) {
+            ok = false;
+        }
+        pos = tns_end_pos;
+    }
+    if (!ok) {
+        return QVariant();
+    }
+
+    qint64 tns_end_pos;
+    return parse(records.constData(), records.size(), pos, tns_end_pos, ok);
+}
+
+
+/**
+ * start decompressing blocks until max_in_flight blocks are
+ * waiting to be consumed
+ */
+void
+ArchiveReader::fill()
+{
+    while ((m_next_block < m_blocks.size()) && (m_in_flight.size() < m_max_in_flight)) {
+        QByteArray raw;
+        if (!read_raw(m_next_block, raw)) {
+            m_read_failed = true;
+            m_next_block = m_blocks.size();
+            break;
+        }
+        m_in_flight.enqueue(QtConcurrent::run(&ArchiveReader::decompress, raw));
+        ++m_next_block;
+    }
+}
+
+
+bool
+ArchiveReader::nextBlock(QByteArray &records, bool &ok)
+{
+    ok = true;
+    fill();
+
+    // a read error is reported after all blocks before it have
+    // been delivered
+    if (m_in_flight.isEmpty()) {
+        ok = !m_read_failed;
+        return false;
+    }
+
+    Result result = m_in_flight.dequeue().result();
+    ok = result.ok;
+    if (!ok) {
+        // nothing after a broken block is delivered
+        while (!m_in_flight.isEmpty()) {
+            m_in_flight.dequeue().waitForFinished();
+        }
+        m_next_block = m_blocks.size();
+        return false;
+    }
+
+    records = result.records;
+    return true;
+}
+
+
+bool
+ArchiveReader::next(QVariant &value, bool &ok)
+{
+    ok = true;
+
+    while (m_current_pos >= m_current.size()) {
+        m_current_pos = 0;
+        if (!nextBlock(m_current, ok)) {
+            m_current.clear();
+            return false;
+        }
+    }
+
+    qint64 tns_end_pos;
+    value = parse(m_current.constData(), m_current.size(), m_current_pos, tns_end_pos, ok);
+    if (!ok) {
+        m_current.clear();
+        m_current_pos = 0;
+        return false;
+    }
+
+    m_current_pos = tns_end_pos;
+    return true;
+}
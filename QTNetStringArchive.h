@@ -0,0 +1,164 @@
+#ifndef __qtnetstring_archive_h__
+#define __qtnetstring_archive_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QList"
+#include "QQueue"
+#include "QFuture"
+
+
+class QIODevice;
+
+
+namespace QTNetString {
+
+    /**
+     * Archive format storing concatenated TNetString records in
+     * independently compressed blocks.
+     *
+     * Layout of an archive:
+     *
+     *      block ... | index | footer
+     *
+     * Every block is a tns list of the codec name, the number of
+     * records and the compressed records as a string. The index is a
+     * tns list with a [offset, size, records] list for every block.
+     * The footer is the offset of the index as a 20 digit integer
+     * tns, so it always is the last 24 bytes of the archive.
+     *
+     * The only codec is "zlib" (qCompress).
+     */
+    class ArchiveWriter {
+    public:
+        /**
+         * a block is compressed as soon as the records collected
+         * for it exceed block_size bytes. level is passed to
+         * qCompress.
+         */
+        ArchiveWriter(QIODevice *device, int block_size = 1024 * 1024, int level = -1);
+        ~ArchiveWriter();
+
+        /**
+         * dump value and add it to the archive.
+         *
+         * sets ok to false if the value could not be dumped or a
+         * block could not be written.
+         */
+        void write(const QVariant &value, bool &ok);
+
+        /**
+         * the same for a record which is already encoded
+         */
+        void writeTns(const QByteArray &tns, bool &ok);
+
+        /**
+         * write the last block, the index and the footer. Nothing
+         * can be written after the archive has been finished.
+         */
+        bool finish();
+
+    private:
+        bool write_block();
+
+        QIODevice *m_device;
+        int m_block_size;
+        int m_level;
+        qint64 m_pos;
+        QByteArray m_records;
+        int m_record_count;
+        QList<QVariant> m_index;
+        bool m_finished;
+
+        Q_DISABLE_COPY(ArchiveWriter)
+    };
+
+    /**
+     * Reads an archive written by ArchiveWriter from a random access
+     * device, e.g. a QFile.
+     *
+     * Reading sequentially with next() or nextBlock() decompresses
+     * the following blocks in the global QThreadPool while the
+     * current one is consumed.
+     */
+    class ArchiveReader {
+    public:
+        /**
+         * at most max_in_flight blocks are decompressed ahead, 0
+         * uses QThread::idealThreadCount().
+         */
+        ArchiveReader(QIODevice *device, int max_in_flight = 0);
+        ~ArchiveReader();
+
+        /**
+         * read the index of the archive. Returns false if the device
+         * does not contain an archive.
+         */
+        bool open();
+
+        int blockCount() const;
+        qint64 recordCount() const;
+
+        /**
+         * the decompressed records of a block, as concatenated
+         * TNetStrings.
+         */
+        QByteArray block(int index, bool &ok);
+
+        /**
+         * parse a single record, only its block is decompressed
+         */
+        QVariant record(qint64 index, bool &ok);
+
+        /**
+         * the decompressed records of the next block. Returns false
+         * at the end of the archive or on errors.
+         */
+        bool nextBlock(QByteArray &records, bool &ok);
+
+        /**
+         * parse the next record of the archive.
+         *
+         * returns false when the end of the archive is reached or
+         * an error occured. ok is set to false if the archive is not
+         * valid.
+         */
+        bool next(QVariant &value, bool &ok);
+
+    private:
+        struct BlockInfo {
+            qint64 offset;
+            int size;
+            qint64 first_record;
+            int records;
+        };
+
+        struct Result {
+            QByteArray records;
+            bool ok;
+        };
+
+        static Result decompress(const QByteArray &block);
+
+        bool read_raw(int index, QByteArray &raw);
+        void fill();
+
+        QIODevice *m_device;
+        int m_max_in_flight;
+        QList<BlockInfo> m_blocks;
+        int m_next_block;
+        bool m_read_failed;
+        QQueue<QFuture<Result> > m_in_flight;
+        QByteArray m_current;
+        qint64 m_current_pos;
+        int m_cached_index;
+        QByteArray m_cached;
+
+        Q_DISABLE_COPY(ArchiveReader)
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,255 @@
+#include "QTNetStringAsync.h"
+#include "QTNetString.h"
+
+#include <QFutureInterface>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QMap>
+#include <QList>
+#include <QDebug>
+
+
+using namespace QTNetString;
+
+
+/**
+ * parse the elements of the container at tns_start_pos one by one so
+ * progress can be reported and cancel requests are noticed.
+ *
+ * returns false and leaves value untouched if the tns is not a
+ * container.
+ */
+static bool
+parse_container(QFutureInterface<QVariant> &interface, const QByteArray &tnetstring,
+            QVariant &value, bool &ok)
+{
+    ok = true;
+
+    int tns_end_pos;
+    if (!frame(tnetstring, 0, tns_end_pos, ok)) {
+        return false;
+    }
+
+    char type = tnetstring.at(tns_end_pos - 1);
+    if ((type != ']') && (type != '}')) {
+        return false;
+    }
+
+    int pl_start = tnetstring.indexOf(':') + 1;
+    int pl_end = tns_end_pos - 1;
+
+    QList<QVariant> list;
+    QMap<QString, QVariant> map;
+    int pos = pl_start;
+    while (ok && (pos < pl_end)) {
+        if (interface.isCanceled()) {
+            return true;
+        }
+
+        int element_end_pos;
+        QVariant element;
+        if (frame(tnetstring, pos, element_end_pos, ok) && (element_end_pos <= pl_end)) {
+            element = parse(tnetstring, pos, element_end_pos, ok);
+        }
+        else {
+            ok = false;
+            break;
+        }
+
+        if (type == ']') {
+            list.append(element);
+            pos = element_end_pos;
+        }
+        else {
+            if (element.type() != QVariant::ByteArray) {
+                qDebug() << "tns map keys are only allowed to be strings";
+                ok = false;
+                break;
+            }
+
+            int value_end_pos;
+            QVariant map_value;
+            if (frame(tnetstring, element_end_pos, value_end_pos, ok)
+                        && (value_end_pos <= pl_end)) {
+                map_value = parse(tnetstring, element_end_pos, value_end_pos, ok);
+            }
+            else {
+                ok = false;
+                break;
+            }
+            map[element.toString()] = map_value;
+            pos = value_end_pos;
+        }
+
+        interface.setProgressValue(pos);
+    }
+
+    if (ok) {
+        if (type == ']') {
+            value.setValue(list);
+        }
+        else {
+            value.setValue(map);
+        }
+    }
+    return true;
+}
+
+
+class ParseTask : public QRunnable {
+public:
+    ParseTask(const QByteArray &tnetstring)
+        : m_tnetstring(tnetstring)
+    {
+        m_interface.reportStarted();
+    }
+
+    QFuture<QVariant> future()
+    {
+        return m_interface.future();
+    }
+
+    void run()
+    {
+        if (!m_interface.isCanceled()) {
+            m_interface.setProgressRange(0, m_tnetstring.size());
+
+            bool ok;
+            QVariant value;
+            if (!parse_container(m_interface, m_tnetstring, value, ok) && ok) {
+                value = parse(m_tnetstring, ok);
+            }
+
+            if (!m_interface.isCanceled()) {
+                if (!ok) {
+                    value.clear();
+                }
+                m_interface.setProgressValue(m_tnetstring.size());
+                m_interface.reportResult(value);
+            }
+        }
+        m_interface.reportFinished();
+    }
+
+private:
+    QFutureInterface<QVariant> m_interface;
+    QByteArray m_tnetstring;
+};
+
+
+/**
+ * append the dumped elements of a list or map to payload one by one
+ * so progress can be reported and cancel requests are noticed.
+ */
+static void
+dump_container(QFutureInterface<QByteArray> &interface, const QVariant &value,
+            QByteArray &payload, bool &ok)
+{
+    ok = true;
+    int done = 0;
+
+    if (value.type() == QVariant::List) {
+        QList<QVariant> list_value = value.toList();
+        interface.setProgressRange(0, list_value.size());
+
+        QList<QVariant>::const_iterator iter = list_value.constBegin();
+        while (iter != list_value.constEnd() && ok && !interface.isCanceled()) {
+            payload.append(dump(*iter, ok));
+            interface.setProgressValue(++done);
+            ++iter;
+        }
+    }
+    else {
+        QMap<QString, QVariant> map_value = value.toMap();
+        interface.setProgressRange(0, map_value.size());
+
+        QMap<QString, QVariant>::const_iterator iter = map_value.constBegin();
+        while (iter != map_value.constEnd() && ok && !interface.isCanceled()) {
+            payload.append(dump(QVariant(iter.key()), ok));
+            if (ok) {
+                payload.append(dump(iter.value(), ok));
+            }
+            interface.setProgressValue(++done);
+            ++iter;
+        }
+    }
+}
+
+
+class DumpTask : public QRunnable {
+public:
+    DumpTask(const QVariant &value)
+        : m_value(value)
+    {
+        m_interface.reportStarted();
+    }
+
+    QFuture<QByteArray> future()
+    {
+        return m_interface.future();
+    }
+
+    void run()
+    {
+        if (!m_interface.isCanceled()) {
+            bool ok;
+            QByteArray tns;
+
+            QVariant::Type type = m_value.type();
+            if ((type == QVariant::List) || (type == QVariant::Map)
+                        || (type == QVariant::Hash)) {
+                QByteArray payload;
+                dump_container(m_interface, m_value, payload, ok);
+                if (ok) {
+                    tns.append(QByteArray::number(payload.size()));
+                    tns.append(':');
+                    tns.append(payload);
+                    tns.append((type == QVariant::List) ? ']' : '}');
+                }
+            }
+            else {
+                tns = dump(m_value, ok);
+            }
+
+            if (!m_interface.isCanceled()) {
+                if (!ok) {
+                    tns.clear();
+                }
+                m_interface.reportResult(tns);
+            }
+        }
+        m_interface.reportFinished();
+    }
+
+private:
+    QFutureInterface<QByteArray> m_interface;
+    QVariant m_value;
+};
+
+
+QFuture<QVariant>
+QTNetString::parseAsync(const QByteArray &tnetstring, QThreadPool *pool)
+{
+    ParseTask *task = new ParseTask(tnetstring);
+    QFuture<QVariant> future = task->future();
+
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+    pool->start(task);
+    return future;
+}
+
+
+QFuture<QByteArray>
+QTNetString::dumpAsync(const QVariant &value, QThreadPool *pool)
+{
+    DumpTask *task = new DumpTask(value);
+    QFuture<QByteArray> future = task->future();
+
+    if (!pool) {
+        pool = QThreadPool::globalInstance();
+    }
+    pool->start(task);
+    return future;
+}
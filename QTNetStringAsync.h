@@ -0,0 +1,46 @@
+#ifndef __qtnetstring_async_h__
+#define __qtnetstring_async_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QFuture"
+
+
+class QThreadPool;
+
+
+namespace QTNetString {
+
+    /**
+     * Parse a TNetString in a QThreadPool.
+     *
+     * When the tnetstring is a list or a map, progress is reported in
+     * bytes of the tnetstring after every element, and a cancel()
+     * of the future stops the parser before the next element.
+     *
+     * The result of the future is QVariant::Invalid if the tnetstring
+     * could not be parsed. A canceled future has no result.
+     *
+     * pool defaults to QThreadPool::globalInstance().
+     */
+    QFuture<QVariant> parseAsync(const QByteArray &tnetstring, QThreadPool *pool = 0);
+
+    /**
+     * Dump a QVariant structure in a QThreadPool.
+     *
+     * When the value is a list or a map, progress is reported in
+     * number of elements, and a cancel() of the future stops the
+     * dump before the next element.
+     *
+     * The result of the future is an empty QByteArray if the value
+     * could not be dumped. A canceled future has no result.
+     *
+     * pool defaults to QThreadPool::globalInstance().
+     */
+    QFuture<QByteArray> dumpAsync(const QVariant &value, QThreadPool *pool = 0);
+
+}
+
+
+#endif
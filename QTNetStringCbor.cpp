@@ -0,0 +1,496 @@
+#include "QTNetStringCbor.h"
+#include "QTNetString.h"
+
+#include <QDebug>
+
+#include <math.h>
+#include <string.h>
+
+
+using namespace QTNetString;
+
+
+enum CborMajorType {
+    CBOR_UINT       = 0,
+    CBOR_NEGINT     = 1,
+    CBOR_BYTES      = 2,
+    CBOR_TEXT       = 3,
+    CBOR_ARRAY      = 4,
+    CBOR_MAP        = 5,
+    CBOR_TAG        = 6,
+    CBOR_SIMPLE     = 7
+};
+
+static const char CBOR_FALSE = char(0xf4);
+static const char CBOR_TRUE = char(0xf5);
+static const char CBOR_NULL = char(0xf6);
+static const char CBOR_DOUBLE = char(0xfb);
+static const char CBOR_BREAK = char(0xff);
+static const int CBOR_INDEFINITE = 31;
+
+
+CborWriter::CborWriter()
+{
+}
+
+
+QByteArray
+CborWriter::cbor() const
+{
+    return m_cbor;
+}
+
+
+/**
+ * the initial byte of a data item followed by its argument in the
+ * shortest possible form
+ */
+void
+CborWriter::append_head(int major, quint64 value)
+{
+    char head = char(major << 5);
+    int bytes;
+
+    if (value < 24) {
+        m_cbor.append(char(head | value));
+        return;
+    }
+    else if (value <= 0xff) {
+        m_cbor.append(char(head | 24));
+        bytes = 1;
+    }
+    else if (value <= 0xffff) {
+        m_cbor.append(char(head | 25));
+        bytes = 2;
+    }
+    else if (value <= 0xffffffffULL) {
+        m_cbor.append(char(head | 26));
+        bytes = 4;
+    }
+    else {
+        m_cbor.append(char(head | 27));
+        bytes = 8;
+    }
+
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        m_cbor.append(char(value >> shift));
+    }
+}
+
+
+bool
+CborWriter::null()
+{
+    m_cbor.append(CBOR_NULL);
+    return true;
+}
+
+
+bool
+CborWriter::boolean(bool value)
+{
+    m_cbor.append(value ? CBOR_TRUE : CBOR_FALSE);
+    return true;
+}
+
+
+bool
+CborWriter::integer(const char *data, int size)
+{
+    QByteArray text = QByteArray::fromRawData(data, size);
+    bool ok;
+
+    qint64 value = text.toLongLong(&ok);
+    if (ok) {
+        if (value < 0) {
+            append_head(CBOR_NEGINT, quint64(-1 - value));
+        }
+        else {
+            append_head(CBOR_UINT, quint64(value));
+        }
+        return true;
+    }
+
+    quint64 unsigned_value = text.toULongLong(&ok);
+    if (ok) {
+        append_head(CBOR_UINT, unsigned_value);
+        return true;
+    }
+
+    qDebug() << "tns integer does not fit into 64 bit: " << text;
+    return false;
+}
+
+
+bool
+CborWriter::floating(const char *data, int size)
+{
+    bool ok;
+    double value = QByteArray::fromRawData(data, size).toDouble(&ok);
+    if (!ok) {
+        qDebug() << "invalid tns float: " << QByteArray(data, size);
+        return false;
+    }
+
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    m_cbor.append(CBOR_DOUBLE);
+    for (int shift = 56; shift >= 0; shift -= 8) {
+        m_cbor.append(char(bits >> shift));
+    }
+    return true;
+}
+
+
+bool
+CborWriter::string(const char *data, int size)
+{
+    // tns strings are bytes, only valid UTF-8 is written as text
+    append_head(isUtf8(data, size) ? CBOR_TEXT : CBOR_BYTES, size);
+    m_cbor.append(data, size);
+    return true;
+}
+
+
+bool
+CborWriter::beginList()
+{
+    m_cbor.append(char((CBOR_ARRAY << 5) | CBOR_INDEFINITE));
+    return true;
+}
+
+
+bool
+CborWriter::endList()
+{
+    m_cbor.append(CBOR_BREAK);
+    return true;
+}
+
+
+bool
+CborWriter::beginMap()
+{
+    m_cbor.append(char((CBOR_MAP << 5) | CBOR_INDEFINITE));
+    return true;
+}
+
+
+bool
+CborWriter::key(const char *data, int size)
+{
+    return string(data, size);
+}
+
+
+bool
+CborWriter::endMap()
+{
+    m_cbor.append(CBOR_BREAK);
+    return true;
+}
+
+
+/**
+ * reads one data item after the other and reports it to the
+ * handler. Definite and indefinite length items are supported.
+ */
+class CborReader {
+public:
+    CborReader(const QByteArray &cbor, Handler &handler)
+        : m_pos(reinterpret_cast<const uchar *>(cbor.constData())),
+          m_end(m_pos + cbor.size()), m_handler(handler), m_depth(0)
+    {
+    }
+
+    bool document()
+    {
+        if (!item(false)) {
+            return false;
+        }
+        if (m_pos != m_end) {
+            qDebug() << "trailing bytes after cbor data item";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool enter()
+    {
+        if (m_depth >= MAX_NESTING_DEPTH) {
+            qDebug() << "cbor is nested too deeply";
+            return false;
+        }
+        ++m_depth;
+        return true;
+    }
+
+    bool at_break()
+    {
+        return (m_pos < m_end) && (*m_pos == 0xff);
+    }
+
+    /**
+     * read the argument following the initial byte. indefinite
+     * is set for the additional information 31.
+     */
+    bool argument(int info, quint64 &value, bool &indefinite)
+    {
+        indefinite = false;
+        if (info < 24) {
+            value = info;
+            return true;
+        }
+        if (info == CBOR_INDEFINITE) {
+            indefinite = true;
+            return true;
+        }
+        if (info > 27) {
+            qDebug() << "invalid cbor additional information: " << info;
+            return false;
+        }
+
+        int bytes = 1 << (info - 24);
+        if ((m_end - m_pos) < bytes) {
+            qDebug() << "unexpected end of cbor";
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value = (value << 8) | *m_pos++;
+        }
+        return true;
+    }
+
+    bool string(int major, quint64 length, bool indefinite, bool is_key)
+    {
+        if (!indefinite) {
+            if (quint64(m_end - m_pos) < length) {
+                qDebug() << "unexpected end of cbor";
+                return false;
+            }
+            const char *data = reinterpret_cast<const char *>(m_pos);
+            m_pos += length;
+            return is_key ? m_handler.key(data, int(length))
+                        : m_handler.string(data, int(length));
+        }
+
+        // indefinite strings are a sequence of definite chunks
+        QByteArray chunks;
+        while (!at_break()) {
+            if ((m_pos >= m_end) || ((*m_pos >> 5) != major)) {
+                qDebug() << "invalid cbor string chunk";
+                return false;
+            }
+            quint64 chunk_length;
+            bool chunk_indefinite;
+            int info = *m_pos++ & 0x1f;
+            if (!argument(info, chunk_length, chunk_indefinite) || chunk_indefinite
+                        || (quint64(m_end - m_pos) < chunk_length)) {
+                qDebug() << "invalid cbor string chunk";
+                return false;
+            }
+            chunks.append(reinterpret_cast<const char *>(m_pos), int(chunk_length));
+            m_pos += chunk_length;
+        }
+        ++m_pos;
+        return is_key ? m_handler.key(chunks.constData(), chunks.size())
+                    : m_handler.string(chunks.constData(), chunks.size());
+    }
+
+    bool simple(int info)
+    {
+        quint64 bits = 0;
+        double value;
+
+        switch (info) {
+            case 20:
+                return m_handler.boolean(false);
+            case 21:
+                return m_handler.boolean(true);
+            case 22:
+            case 23:
+                return m_handler.null();
+            case 25: {
+                bool indefinite;
+                if (!argument(info, bits, indefinite)) {
+                    return false;
+                }
+                // half precision float
+                int exponent = (bits >> 10) & 0x1f;
+                int mantissa = bits & 0x3ff;
+                if (exponent == 0) {
+                    value = ldexp(double(mantissa), -24);
+                }
+                else if (exponent != 31) {
+                    value = ldexp(double(mantissa + 1024), exponent - 25);
+                }
+                else {
+                    value = mantissa ? NAN : INFINITY;
+                }
+                if (bits & 0x8000) {
+                    value = -value;
+                }
+                break;
+            }
+            case 26: {
+                bool indefinite;
+                if (!argument(info, bits, indefinite)) {
+                    return false;
+                }
+                quint32 bits32 = quint32(bits);
+                float value32;
+                memcpy(&value32, &bits32, sizeof(value32));
+                value = value32;
+                break;
+            }
+            case 27: {
+                bool indefinite;
+                if (!argument(info, bits, indefinite)) {
+                    return false;
+                }
+                memcpy(&value, &bits, sizeof(value));
+                break;
+            }
+            default:
+                qDebug() << "unsupported cbor simple value: " << info;
+                return false;
+        }
+
+        QByteArray text = QByteArray::number(value, 'g', 17);
+        return m_handler.floating(text.constData(), text.size());
+    }
+
+    bool item(bool is_key)
+    {
+        if (m_pos >= m_end) {
+            qDebug() << "unexpected end of cbor";
+            return false;
+        }
+
+        int major = *m_pos >> 5;
+        int info = *m_pos & 0x1f;
+        ++m_pos;
+
+        if (is_key && (major != CBOR_TEXT) && (major != CBOR_BYTES) && (major != CBOR_TAG)) {
+            qDebug() << "tns map keys are only allowed to be strings";
+            return false;
+        }
+        if (major == CBOR_SIMPLE) {
+            return simple(info);
+        }
+
+        quint64 value;
+        bool indefinite;
+        if (!argument(info, value, indefinite)) {
+            return false;
+        }
+        if (indefinite && ((major == CBOR_UINT) || (major == CBOR_NEGINT)
+                    || (major == CBOR_TAG))) {
+            qDebug() << "cbor major type " << major << " can not have indefinite length";
+            return false;
+        }
+
+        switch (major) {
+            case CBOR_UINT:
+            case CBOR_NEGINT: {
+                QByteArray text;
+                if (major == CBOR_UINT) {
+                    text = QByteArray::number(value);
+                }
+                else if (value <= quint64(0x7fffffffffffffffLL)) {
+                    text = QByteArray::number(-1 - qint64(value));
+                }
+                else {
+                    qDebug() << "cbor negative integer does not fit into 64 bit";
+                    return false;
+                }
+                return m_handler.integer(text.constData(), text.size());
+            }
+            case CBOR_BYTES:
+            case CBOR_TEXT:
+                return string(major, value, indefinite, is_key);
+            case CBOR_ARRAY: {
+                if (!enter() || !m_handler.beginList()) {
+                    return false;
+                }
+                for (quint64 i = 0; indefinite ? !at_break() : (i < value); ++i) {
+                    if (!item(false)) {
+                        return false;
+                    }
+                }
+                if (indefinite) {
+                    ++m_pos;
+                }
+                --m_depth;
+                return m_handler.endList();
+            }
+            case CBOR_MAP: {
+                if (!enter() || !m_handler.beginMap()) {
+                    return false;
+                }
+                for (quint64 i = 0; indefinite ? !at_break() : (i < value); ++i) {
+                    if (!item(true) || !item(false)) {
+                        return false;
+                    }
+                }
+                if (indefinite) {
+                    ++m_pos;
+                }
+                --m_depth;
+                return m_handler.endMap();
+            }
+            case CBOR_TAG: {
+                // the tag itself carries no information for tns, but
+                // tags of tags nest like containers
+                if (!enter() || !item(is_key)) {
+                    return false;
+                }
+                --m_depth;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const uchar *m_pos;
+    const uchar *m_end;
+    Handler &m_handler;
+    int m_depth;
+};
+
+
+void
+QTNetString::readCbor(const QByteArray &cbor, Handler &handler, bool &ok)
+{
+    CborReader reader(cbor, handler);
+    ok = reader.document();
+}
+
+
+QByteArray
+QTNetString::toCbor(const QByteArray &tnetstring, bool &ok)
+{
+    CborWriter writer;
+    qint64 tns_end_pos;
+
+    walk(tnetstring.constData(), tnetstring.size(), 0, tns_end_pos, writer, ok);
+    if (!ok) {
+        return QByteArray();
+    }
+    return writer.cbor();
+}
+
+
+QByteArray
+QTNetString::fromCbor(const QByteArray &cbor, bool &ok)
+{
+    Writer writer;
+
+    readCbor(cbor, writer, ok);
+    if (!ok) {
+        return QByteArray();
+    }
+    return writer.tns();
+}
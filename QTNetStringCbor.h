@@ -0,0 +1,76 @@
+#ifndef __qtnetstring_cbor_h__
+#define __qtnetstring_cbor_h__
+
+
+#include "QByteArray"
+
+#include "QTNetStringSax.h"
+
+
+namespace QTNetString {
+
+    /**
+     * Convert a TNetString to CBOR (RFC 7049) without building a
+     * QVariant structure in between.
+     *
+     * Lists and maps are written with indefinite length, so the
+     * output is produced in a single pass. TNetString strings and
+     * map keys which are valid UTF-8 become CBOR text strings, all
+     * others byte strings, as TNetString strings may hold any bytes.
+     *
+     * sets ok to false and returns an empty QByteArray if the
+     * tnetstring is not valid.
+     */
+    QByteArray toCbor(const QByteArray &tnetstring, bool &ok);
+
+    /**
+     * Convert a CBOR data item to a TNetString without building a
+     * QVariant structure in between.
+     *
+     * Text and byte strings both become TNetString strings, tags are
+     * ignored and undefined becomes null.
+     *
+     * sets ok to false and returns an empty QByteArray if the cbor
+     * is not valid, nested deeper than MAX_NESTING_DEPTH or contains
+     * map keys which are not strings.
+     */
+    QByteArray fromCbor(const QByteArray &cbor, bool &ok);
+
+    /**
+     * Report the contents of a CBOR data item to handler in the same
+     * way walk() reports the contents of a TNetString.
+     */
+    void readCbor(const QByteArray &cbor, Handler &handler, bool &ok);
+
+    /**
+     * A handler which encodes the events it receives as CBOR.
+     */
+    class CborWriter : public Handler {
+    public:
+        CborWriter();
+
+        QByteArray cbor() const;
+
+        bool null();
+        bool boolean(bool value);
+        bool integer(const char *data, int size);
+        bool floating(const char *data, int size);
+        bool string(const char *data, int size);
+
+        bool beginList();
+        bool endList();
+
+        bool beginMap();
+        bool key(const char *data, int size);
+        bool endMap();
+
+    private:
+        void append_head(int major, quint64 value);
+
+        QByteArray m_cbor;
+    };
+
+}
+
+
+#endif
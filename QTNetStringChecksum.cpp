@@ -0,0 +1,253 @@
+#include "QTNetStringChecksum.h"
+#include "QTNetString.h"
+
+#include <QDebug>
+
+#include <string.h>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define QTNETSTRING_CRC32C_SSE42
+#include <cpuid.h>
+#include <nmmintrin.h>
+#endif
+
+
+using namespace QTNetString;
+
+/* "4:" + 4 bytes + "," */
+static const int CHECKSUM_SIZE = 7;
+/* reflected Castagnoli polynomial */
+static const quint32 CRC32C_POLYNOMIAL = 0x82f63b78;
+
+
+/**
+ * the eight tables of the slicing-by-8 implementation, computed
+ * once when the library is loaded
+ */
+struct Crc32cTables {
+    Crc32cTables()
+    {
+        for (quint32 i = 0; i < 256; ++i) {
+            quint32 crc = i;
+            for (int bit = 0; bit < 8; ++bit) {
+                crc = (crc >> 1) ^ ((crc & 1) ? CRC32C_POLYNOMIAL : 0);
+            }
+            table[0][i] = crc;
+        }
+        for (int t = 1; t < 8; ++t) {
+            for (int i = 0; i < 256; ++i) {
+                table[t][i] = (table[t - 1][i] >> 8) ^ table[0][table[t - 1][i] & 0xff];
+            }
+        }
+    }
+
+    quint32 table[8][256];
+};
+
+static const Crc32cTables CRC32C_TABLES;
+
+
+static quint32
+crc32c_slicing(const uchar *data, qint64 size, quint32 crc)
+{
+    const quint32 (*table)[256] = CRC32C_TABLES.table;
+
+    for (; (size > 0) && (reinterpret_cast<quintptr>(data) & 7); --size) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xff];
+    }
+
+    for (; size >= 8; size -= 8, data += 8) {
+        quint32 low = crc ^ (quint32(data[0]) | (quint32(data[1]) << 8)
+                    | (quint32(data[2]) << 16) | (quint32(data[3]) << 24));
+        crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff]
+                    ^ table[5][(low >> 16) & 0xff] ^ table[4][low >> 24]
+                    ^ table[3][data[4]] ^ table[2][data[5]]
+                    ^ table[1][data[6]] ^ table[0][data[7]];
+    }
+
+    for (; size > 0; --size) {
+        crc = (crc >> 8) ^ table[0][(crc ^ *data++) & 0xff];
+    }
+    return crc;
+}
+
+
+#ifdef QTNETSTRING_CRC32C_SSE42
+
+__attribute__((target("sse4.2"))) static quint32
+crc32c_sse42(const uchar *data, qint64 size, quint32 crc)
+{
+    for (; (size > 0) && (reinterpret_cast<quintptr>(data) & 7); --size) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+
+#ifdef __x86_64__
+    quint64 crc64 = crc;
+    for (; size >= 8; size -= 8, data += 8) {
+        quint64 value;
+        memcpy(&value, data, sizeof(value));
+        crc64 = _mm_crc32_u64(crc64, value);
+    }
+    crc = quint32(crc64);
+#endif
+
+    for (; size >= 4; size -= 4, data += 4) {
+        quint32 value;
+        memcpy(&value, data, sizeof(value));
+        crc = _mm_crc32_u32(crc, value);
+    }
+
+    for (; size > 0; --size) {
+        crc = _mm_crc32_u8(crc, *data++);
+    }
+    return crc;
+}
+
+
+static bool
+has_sse42()
+{
+    unsigned int eax, ebx, ecx, edx;
+    return __get_cpuid(1, &eax, &ebx, &ecx, &edx) && (ecx & bit_SSE4_2);
+}
+
+static const bool HAS_SSE42 = has_sse42();
+
+#endif
+
+
+quint32
+QTNetString::crc32c(const char *data, qint64 size, quint32 crc)
+{
+    const uchar *bytes = reinterpret_cast<const uchar *>(data);
+
+#ifdef QTNETSTRING_CRC32C_SSE42
+    if (HAS_SSE42) {
+        return ~crc32c_sse42(bytes, size, ~crc);
+    }
+#endif
+    return ~crc32c_slicing(bytes, size, ~crc);
+}
+
+
+void
+QTNetString::appendChecked(QByteArray &out, const QByteArray &tns)
+{
+    quint32 crc = crc32c(tns.constData(), tns.size());
+
+    out.append(tns);
+    out.append("4:", 2);
+    out.append(char(crc >> 24));
+    out.append(char(crc >> 16));
+    out.append(char(crc >> 8));
+    out.append(char(crc));
+    out.append(',');
+}
+
+
+QByteArray
+QTNetString::dumpChecked(const QVariant &value, bool &ok)
+{
+    QByteArray checked;
+    QByteArray tns = dump(value, ok);
+    if (ok) {
+        appendChecked(checked, tns);
+    }
+    return checked;
+}
+
+
+bool
+QTNetString::checkedFrame(const char *data, qint64 data_size, qint64 tns_start_pos,
+            qint64 &tns_end_pos, qint64 &frame_end_pos, bool &ok)
+{
+    if (!frame(data, data_size, tns_start_pos, tns_end_pos, ok)) {
+        return false;
+    }
+    if ((data_size - tns_end_pos) < CHECKSUM_SIZE) {
+        return false;
+    }
+
+    const uchar *checksum = reinterpret_cast<const uchar *>(data + tns_end_pos);
+    if ((checksum[0] != '4') || (checksum[1] != ':') || (checksum[6] != ',')) {
+        qDebug() << "tns is not followed by a checksum";
+        ok = false;
+        return false;
+    }
+
+    quint32 expected = (quint32(checksum[2]) << 24) | (quint32(checksum[3]) << 16)
+                | (quint32(checksum[4]) << 8) | quint32(checksum[5]);
+    if (crc32c(data + tns_start_pos, tns_end_pos - tns_start_pos) != expected) {
+        qDebug() << "checksum mismatch at offset " << tns_start_pos;
+        ok = false;
+        return false;
+    }
+
+    frame_end_pos = tns_end_pos + CHECKSUM_SIZE;
+    return true;
+}
+
+
+CheckedDecoder::CheckedDecoder()
+    : m_pos(0)
+{
+}
+
+
+void
+CheckedDecoder::feed(const QByteArray &data)
+{
+    // drop the already consumed bytes before the buffer grows
+    if (m_pos > 0) {
+        m_buffer.remove(0, m_pos);
+        m_pos = 0;
+    }
+    m_buffer.append(data);
+}
+
+
+bool
+CheckedDecoder::nextFrame(QByteArray &tns, bool &ok)
+{
+    qint64 tns_end_pos;
+    qint64 frame_end_pos;
+    if (!checkedFrame(m_buffer.constData(), m_buffer.size(), m_pos, tns_end_pos,
+                frame_end_pos, ok)) {
+        return false;
+    }
+
+    tns = m_buffer.mid(m_pos, int(tns_end_pos - m_pos));
+    m_pos = int(frame_end_pos);
+    return true;
+}
+
+
+bool
+CheckedDecoder::next(QVariant &value, bool &ok)
+{
+    qint64 tns_end_pos;
+    qint64 frame_end_pos;
+    if (!checkedFrame(m_buffer.constData(), m_buffer.size(), m_pos, tns_end_pos,
+                frame_end_pos, ok)) {
+        return false;
+    }
+
+    value = parse(m_buffer.constData(), tns_end_pos, m_pos, tns_end_pos, ok);
+    m_pos = int(frame_end_pos);
+    return ok;
+}
+
+
+int
+CheckedDecoder::bufferedBytes() const
+{
+    return m_buffer.size() - m_pos;
+}
+
+
+void
+CheckedDecoder::reset()
+{
+    m_buffer.clear();
+    m_pos = 0;
+}
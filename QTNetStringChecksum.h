@@ -0,0 +1,88 @@
+#ifndef __qtnetstring_checksum_h__
+#define __qtnetstring_checksum_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+
+
+namespace QTNetString {
+
+    /**
+     * CRC-32C (Castagnoli) of data, as used by iSCSI and ext4.
+     *
+     * Uses the crc32 instruction of SSE 4.2 when the processor has
+     * it and a slicing-by-8 table implementation otherwise. Pass the
+     * result of a previous call as crc to continue a checksum over
+     * several pieces of data.
+     */
+    quint32 crc32c(const char *data, qint64 size, quint32 crc = 0);
+
+    /**
+     * Checksummed framing: every tns is followed by its CRC-32C as a
+     * 4 byte big endian tns string, "4:" + crc + ",". The result is
+     * still a stream of concatenated TNetStrings.
+     *
+     * The tns may be a single record or a whole block of records,
+     * e.g. a list or an archive block.
+     */
+    void appendChecked(QByteArray &out, const QByteArray &tns);
+
+    /**
+     * dump value and return it with its checksum appended.
+     */
+    QByteArray dumpChecked(const QVariant &value, bool &ok);
+
+    /**
+     * the same as frame, for a tns followed by its checksum.
+     *
+     * returns true if data contains the complete tns and checksum,
+     * writes the end of the tns to tns_end_pos and the end of the
+     * checksum to frame_end_pos. ok is set to false if the data is
+     * not valid or the checksum does not match.
+     */
+    bool checkedFrame(const char *data, qint64 data_size, qint64 tns_start_pos,
+                qint64 &tns_end_pos, qint64 &frame_end_pos, bool &ok);
+
+    /**
+     * Incremental decoder like QTNetString::Decoder for a stream of
+     * checksummed frames. Every frame is verified before it is
+     * returned.
+     */
+    class CheckedDecoder {
+    public:
+        CheckedDecoder();
+
+        /**
+         * append data to the bytes waiting to be decoded
+         */
+        void feed(const QByteArray &data);
+
+        /**
+         * decode the next complete value.
+         *
+         * returns false if the buffered bytes do not contain a
+         * complete frame yet. ok is set to false if the stream is not
+         * valid or a checksum does not match, the decoder should be
+         * reset() in this case.
+         */
+        bool next(QVariant &value, bool &ok);
+
+        /**
+         * the same as next() but returns the verified tns without
+         * parsing it.
+         */
+        bool nextFrame(QByteArray &tns, bool &ok);
+
+        int bufferedBytes() const;
+        void reset();
+
+    private:
+        QByteArray m_buffer;
+        int m_pos;
+    };
+
+}
+
+
+#endif
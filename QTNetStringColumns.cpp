@@ -0,0 +1,205 @@
+#include "QTNetStringColumns.h"
+#include "QTNetString.h"
+
+#include <QVariant>
+#include <QDebug>
+
+
+using namespace QTNetString;
+
+
+ColumnExtractor::ColumnExtractor()
+    : m_rows(0)
+{
+}
+
+
+int
+ColumnExtractor::addColumn(const QStringList &path, ColumnType type)
+{
+    Column column;
+    column.type = type;
+    for (int i = 0; i < path.size(); ++i) {
+        column.path.append(QVariant(path.at(i)).toByteArray());
+    }
+
+    // the new column has no values for the rows extracted so far
+    column.present.fill(false, m_rows);
+    if (type == IntColumn) {
+        column.integers.fill(0, m_rows);
+    }
+    else if (type == FloatColumn) {
+        column.floats.fill(0.0, m_rows);
+    }
+    else {
+        column.ends.fill(0, m_rows);
+    }
+
+    m_columns.append(column);
+    return m_columns.size() - 1;
+}
+
+
+void
+ColumnExtractor::extract_record(const QByteArray &record, bool &ok)
+{
+    Element root;
+    if (!elementAt(record, 0, record.size(), root, ok)) {
+        return;
+    }
+
+    // find the values of all columns first, so a record which turns
+    // out to be invalid does not add to some of the columns only
+    QVector<Element> elements(m_columns.size());
+    QVector<bool> found(m_columns.size(), true);
+    for (int i = 0; i < m_columns.size(); ++i) {
+        const Column &column = m_columns.at(i);
+
+        elements[i] = root;
+        for (int depth = 0; found.at(i) && (depth < column.path.size()); ++depth) {
+            Element child;
+            found[i] = findChild(record, elements.at(i), column.path.at(depth), child, ok);
+            if (found.at(i)) {
+                elements[i] = child;
+            }
+        }
+        if (!ok) {
+            return;
+        }
+    }
+
+    for (int i = 0; i < m_columns.size(); ++i) {
+        Column &column = m_columns[i];
+        const Element &element = elements.at(i);
+
+        QByteArray payload = QByteArray::fromRawData(record.constData() + element.pl_start,
+                    element.pl_end - element.pl_start);
+        bool converted = false;
+
+        switch (column.type) {
+            case IntColumn: {
+                qint64 value = 0;
+                if (found.at(i) && (element.type == '#')) {
+                    value = payload.toLongLong(&converted);
+                }
+                column.integers.append(converted ? value : 0);
+                break;
+            }
+            case FloatColumn: {
+                double value = 0.0;
+                if (found.at(i) && ((element.type == '^') || (element.type == '#'))) {
+                    value = payload.toDouble(&converted);
+                }
+                column.floats.append(converted ? value : 0.0);
+                break;
+            }
+            case StringColumn:
+                // scalars are stored with their text
+                converted = found.at(i) && (element.type != ']') && (element.type != '}')
+                            && (element.type != '~');
+                if (converted) {
+                    column.arena.append(payload);
+                }
+                column.ends.append(column.arena.size());
+                break;
+        }
+        column.present.append(converted);
+    }
+    ++m_rows;
+}
+
+
+void
+ColumnExtractor::extract(const char *data, qint64 data_size, bool &ok)
+{
+    qint64 pos = 0;
+
+    ok = true;
+    while (ok && (pos < data_size)) {
+        qint64 tns_end_pos;
+        if (!frame(data, data_size, pos, tns_end_pos, ok)) {
+            if (ok) {
+                qDebug() << "data ends with an incomplete tns";
+                ok = false;
+            }
+            break;
+        }
+
+        QByteArray record = QByteArray::fromRawData(data + pos, int(tns_end_pos - pos));
+        extract_record(record, ok);
+        pos = tns_end_pos;
+    }
+}
+
+
+void
+ColumnExtractor::clear()
+{
+    for (int i = 0; i < m_columns.size(); ++i) {
+        Column &column = m_columns[i];
+        column.present.clear();
+        column.integers.clear();
+        column.floats.clear();
+        column.arena.clear();
+        column.ends.clear();
+    }
+    m_rows = 0;
+}
+
+
+int
+ColumnExtractor::columnCount() const
+{
+    return m_columns.size();
+}
+
+
+int
+ColumnExtractor::rowCount() const
+{
+    return m_rows;
+}
+
+
+const QVector<bool> &
+ColumnExtractor::present(int column) const
+{
+    return m_columns.at(column).present;
+}
+
+
+const QVector<qint64> &
+ColumnExtractor::integers(int column) const
+{
+    return m_columns.at(column).integers;
+}
+
+
+const QVector<double> &
+ColumnExtractor::floats(int column) const
+{
+    return m_columns.at(column).floats;
+}
+
+
+QByteArray
+ColumnExtractor::string(int column, int row) const
+{
+    const Column &c = m_columns.at(column);
+    int start = (row > 0) ? c.ends.at(row - 1) : 0;
+    return c.arena.mid(start, c.ends.at(row) - start);
+}
+
+
+const QByteArray &
+ColumnExtractor::stringArena(int column) const
+{
+    return m_columns.at(column).arena;
+}
+
+
+const QVector<int> &
+ColumnExtractor::stringEnds(int column) const
+{
+    return m_columns.at(column).ends;
+}
@@ -0,0 +1,98 @@
+#ifndef __qtnetstring_columns_h__
+#define __qtnetstring_columns_h__
+
+
+#include "QByteArray"
+#include "QStringList"
+#include "QVector"
+#include "QList"
+
+
+namespace QTNetString {
+
+    /**
+     * Extracts single fields from a stream of concatenated TNetString
+     * records into typed columns.
+     *
+     * The fields are located by skipping over the other elements of
+     * the records using their size prefixes, only the extracted values
+     * are converted. Strings of a column are stored one after the
+     * other in a single QByteArray.
+     *
+     * Records which do not contain a field, or contain it with a type
+     * which does not fit to the column, get a 0 or empty value and are
+     * marked as not present.
+     */
+    class ColumnExtractor {
+    public:
+        enum ColumnType {
+            IntColumn,
+            FloatColumn,
+            StringColumn
+        };
+
+        ColumnExtractor();
+
+        /**
+         * add a column for the value at path, a list of map keys and
+         * list indexes inside of every record. Returns the number of
+         * the column.
+         */
+        int addColumn(const QStringList &path, ColumnType type);
+
+        /**
+         * extract the columns from all records in data and append
+         * them to the columns.
+         *
+         * sets ok to false if data contains something which is not
+         * a tns. The rows of the records before it are kept.
+         */
+        void extract(const char *data, qint64 data_size, bool &ok);
+
+        void clear();
+
+        int columnCount() const;
+        int rowCount() const;
+
+        /**
+         * true for the rows of a column where a value was found
+         */
+        const QVector<bool> &present(int column) const;
+
+        const QVector<qint64> &integers(int column) const;
+        const QVector<double> &floats(int column) const;
+
+        /**
+         * the string of a row of a StringColumn
+         */
+        QByteArray string(int column, int row) const;
+
+        /**
+         * all strings of a StringColumn, the string of row i ends at
+         * stringEnds(column)[i] and starts where the one of the
+         * previous row ends.
+         */
+        const QByteArray &stringArena(int column) const;
+        const QVector<int> &stringEnds(int column) const;
+
+    private:
+        struct Column {
+            QList<QByteArray> path;
+            ColumnType type;
+            QVector<bool> present;
+            QVector<qint64> integers;
+            QVector<double> floats;
+            QByteArray arena;
+            QVector<int> ends;
+        };
+
+        void extract_record(const QByteArray &record, bool &ok);
+
+        QList<Column> m_columns;
+        int m_rows;
+    };
+
+}
+
+
+#endif
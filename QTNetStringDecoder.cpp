@@ -0,0 +1,66 @@
+#include "QTNetStringDecoder.h"
+#include "QTNetString.h"
+
+
+using namespace QTNetString;
+
+
+Decoder::Decoder()
+    : m_pos(0)
+{
+}
+
+
+void
+Decoder::feed(const QByteArray &data)
+{
+    // drop the already consumed bytes before the buffer grows
+    if (m_pos > 0) {
+        m_buffer.remove(0, m_pos);
+        m_pos = 0;
+    }
+    m_buffer.append(data);
+}
+
+
+bool
+Decoder::nextFrame(QByteArray &tns, bool &ok)
+{
+    int tns_end_pos;
+    if (!frame(m_buffer, m_pos, tns_end_pos, ok)) {
+        return false;
+    }
+
+    tns = m_buffer.mid(m_pos, tns_end_pos - m_pos);
+    m_pos = tns_end_pos;
+    return true;
+}
+
+
+bool
+Decoder::next(QVariant &value, bool &ok)
+{
+    int tns_end_pos;
+    if (!frame(m_buffer, m_pos, tns_end_pos, ok)) {
+        return false;
+    }
+
+    value = parse(m_buffer, m_pos, tns_end_pos, ok);
+    m_pos = tns_end_pos;
+    return ok;
+}
+
+
+int
+Decoder::bufferedBytes() const
+{
+    return m_buffer.size() - m_pos;
+}
+
+
+void
+Decoder::reset()
+{
+    m_buffer.clear();
+    m_pos = 0;
+}
@@ -0,0 +1,64 @@
+#ifndef __qtnetstring_decoder_h__
+#define __qtnetstring_decoder_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+
+
+namespace QTNetString {
+
+    /**
+     * Incremental decoder for a stream of concatenated TNetStrings
+     * which arrive in arbitrary pieces, e.g. from a socket.
+     *
+     * Bytes are handed to the decoder with feed() as they arrive.
+     * next() returns the complete values one after the other and
+     * tells when more bytes are needed, so no thread has to block
+     * on the source of the stream.
+     */
+    class Decoder {
+    public:
+        Decoder();
+
+        /**
+         * append data to the bytes waiting to be decoded
+         */
+        void feed(const QByteArray &data);
+
+        /**
+         * decode the next complete value.
+         *
+         * returns false if the buffered bytes do not contain a
+         * complete tns yet. ok is set to false if the stream is
+         * not a valid tns, the decoder should be reset() in
+         * this case.
+         */
+        bool next(QVariant &value, bool &ok);
+
+        /**
+         * the same as next() but returns the encoded tns without
+         * parsing it.
+         */
+        bool nextFrame(QByteArray &tns, bool &ok);
+
+        /**
+         * number of bytes fed which do not belong to a returned
+         * value yet.
+         */
+        int bufferedBytes() const;
+
+        /**
+         * drop all buffered bytes
+         */
+        void reset();
+
+    private:
+        QByteArray m_buffer;
+        int m_pos;
+    };
+
+}
+
+
+#endif
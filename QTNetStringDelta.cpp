@@ -0,0 +1,274 @@
+#include "QTNetStringDelta.h"
+#include "QTNetString.h"
+#include "QTNetStringDocument.h"
+
+#include <QList>
+#include <QMap>
+#include <QStringList>
+#include <QDebug>
+
+#include <string.h>
+
+
+using namespace QTNetString;
+
+
+/**
+ * wrap payload into a tns of the given type and append it to tns
+ */
+inline void
+append_tns(QByteArray &tns, const QByteArray &payload, char type)
+{
+    tns.append(QByteArray::number(payload.size()));
+    tns.append(':');
+    tns.append(payload);
+    tns.append(type);
+}
+
+
+/**
+ * an operation of the delta. path holds the encoded path elements
+ * without the surrounding list.
+ */
+static QByteArray
+delta_operation(const QByteArray &path, const QByteArray &data, const Element *value)
+{
+    QByteArray payload;
+    QByteArray path_list;
+
+    append_tns(path_list, path, ']');
+    if (value) {
+        append_tns(payload, "set", ',');
+        payload.append(path_list);
+        payload.append(data.constData() + value->start, value->end - value->start);
+    }
+    else {
+        append_tns(payload, "remove", ',');
+        payload.append(path_list);
+    }
+
+    QByteArray operation;
+    append_tns(operation, payload, ']');
+    return operation;
+}
+
+
+/**
+ * Document addresses values by QString paths, map keys which do not
+ * survive the conversion to QString and back can not be part of a
+ * path
+ */
+inline bool
+is_path_component(const QByteArray &component)
+{
+    return QVariant(QVariant(component).toString()).toByteArray() == component;
+}
+
+
+inline QByteArray
+child_path(const QByteArray &path, const QByteArray &component)
+{
+    QByteArray child = path;
+    append_tns(child, component, ',');
+    return child;
+}
+
+
+/**
+ * append the operations which turn the from element into the to
+ * element to operations
+ */
+static void
+diff_element(const QByteArray &from, const Element &from_element, const QByteArray &to,
+            const Element &to_element, const QByteArray &path, QByteArray &operations,
+            bool &ok)
+{
+    int from_size = from_element.end - from_element.start;
+    int to_size = to_element.end - to_element.start;
+    if ((from_size == to_size)
+                && (memcmp(from.constData() + from_element.start,
+                        to.constData() + to_element.start, from_size) == 0)) {
+        return;
+    }
+
+    QByteArray child_operations;
+    bool replace = false;
+    if ((from_element.type == '}') && (to_element.type == '}')) {
+        QMap<QByteArray, Element> to_values;
+        Element key;
+        Element value;
+        int pos = to_element.pl_start;
+        while (ok && (pos < to_element.pl_end)
+                    && elementAt(to, pos, to_element.pl_end, key, ok)
+                    && elementAt(to, key.end, to_element.pl_end, value, ok)) {
+            QByteArray key_bytes = to.mid(key.pl_start, key.pl_end - key.pl_start);
+            replace = replace || !is_path_component(key_bytes);
+            to_values.insert(key_bytes, value);
+            pos = value.end;
+        }
+
+        pos = from_element.pl_start;
+        while (ok && (pos < from_element.pl_end)
+                    && elementAt(from, pos, from_element.pl_end, key, ok)
+                    && elementAt(from, key.end, from_element.pl_end, value, ok)) {
+            QByteArray key_bytes = from.mid(key.pl_start, key.pl_end - key.pl_start);
+            replace = replace || !is_path_component(key_bytes);
+            QMap<QByteArray, Element>::iterator to_value = to_values.find(key_bytes);
+            if (to_value == to_values.end()) {
+                child_operations.append(delta_operation(child_path(path, key_bytes), to, 0));
+            }
+            else {
+                diff_element(from, value, to, to_value.value(), child_path(path, key_bytes),
+                            child_operations, ok);
+                to_values.erase(to_value);
+            }
+            pos = value.end;
+        }
+
+        // keys which only exist in to
+        QMap<QByteArray, Element>::const_iterator iter = to_values.constBegin();
+        for (; ok && (iter != to_values.constEnd()); ++iter) {
+            child_operations.append(delta_operation(child_path(path, iter.key()), to,
+                        &iter.value()));
+        }
+    }
+    else if ((from_element.type == ']') && (to_element.type == ']')) {
+        Element from_value;
+        Element to_value;
+        int from_pos = from_element.pl_start;
+        int to_pos = to_element.pl_start;
+        int index = 0;
+
+        while (ok && ((from_pos < from_element.pl_end) || (to_pos < to_element.pl_end))) {
+            QByteArray index_path = child_path(path, QByteArray::number(index));
+            bool has_from = (from_pos < from_element.pl_end)
+                        && elementAt(from, from_pos, from_element.pl_end, from_value, ok);
+            bool has_to = ok && (to_pos < to_element.pl_end)
+                        && elementAt(to, to_pos, to_element.pl_end, to_value, ok);
+
+            if (has_from && has_to) {
+                diff_element(from, from_value, to, to_value, index_path, child_operations, ok);
+            }
+            else if (has_from) {
+                // removing keeps the indexes of the following elements
+                child_operations.append(delta_operation(index_path, to, 0));
+            }
+            else if (has_to) {
+                child_operations.append(delta_operation(index_path, to, &to_value));
+            }
+
+            from_pos = has_from ? from_value.end : from_element.pl_end;
+            to_pos = has_to ? to_value.end : to_element.pl_end;
+            ++index;
+        }
+    }
+
+    // replace the whole value if that is not larger than the changes,
+    // or if the changes are below keys which can not be a path
+    if (replace || child_operations.isEmpty() || (child_operations.size() >= to_size)) {
+        operations.append(delta_operation(path, to, &to_element));
+    }
+    else {
+        operations.append(child_operations);
+    }
+}
+
+
+QByteArray
+QTNetString::diff(const QByteArray &from, const QByteArray &to, bool &ok)
+{
+    ok = true;
+
+    Element from_element;
+    Element to_element;
+    if (!elementAt(from, 0, from.size(), from_element, ok)
+                || !elementAt(to, 0, to.size(), to_element, ok)) {
+        return QByteArray();
+    }
+
+    QByteArray operations;
+    diff_element(from, from_element, to, to_element, QByteArray(), operations, ok);
+    if (!ok) {
+        return QByteArray();
+    }
+
+    QByteArray delta;
+    append_tns(delta, operations, ']');
+    return delta;
+}
+
+
+QByteArray
+QTNetString::patch(const QByteArray &from, const QByteArray &delta, bool &ok)
+{
+    ok = true;
+    Document document(from);
+
+    Element operations;
+    if (!elementAt(delta, 0, delta.size(), operations, ok) || (operations.type != ']')) {
+        qDebug() << "delta is not a list of operations";
+        ok = false;
+        return QByteArray();
+    }
+
+    Element operation;
+    int pos = operations.pl_start;
+    while (ok && (pos < operations.pl_end)
+                && elementAt(delta, pos, operations.pl_end, operation, ok)) {
+        pos = operation.end;
+
+        Element kind;
+        Element path;
+        if ((operation.type != ']')
+                    || !elementAt(delta, operation.pl_start, operation.pl_end, kind, ok)
+                    || !elementAt(delta, kind.end, operation.pl_end, path, ok)
+                    || (path.type != ']')) {
+            qDebug() << "invalid delta operation";
+            ok = false;
+            break;
+        }
+
+        QStringList path_list;
+        Element component;
+        int component_pos = path.pl_start;
+        while (ok && (component_pos < path.pl_end)
+                    && elementAt(delta, component_pos, path.pl_end, component, ok)) {
+            QByteArray component_bytes = delta.mid(component.pl_start,
+                        component.pl_end - component.pl_start);
+            if (!is_path_component(component_bytes)) {
+                qDebug() << "delta path contains a key which is not supported: "
+                            << component_bytes;
+                ok = false;
+                break;
+            }
+            path_list.append(QVariant(component_bytes).toString());
+            component_pos = component.end;
+        }
+        if (!ok) {
+            break;
+        }
+
+        QByteArray kind_bytes = delta.mid(kind.pl_start, kind.pl_end - kind.pl_start);
+        if (kind_bytes == "remove") {
+            document.remove(path_list, ok);
+        }
+        else if (kind_bytes == "set") {
+            // the value is copied into the result as it is
+            Element value;
+            if (elementAt(delta, path.end, operation.pl_end, value, ok)) {
+                QByteArray value_tns = delta.mid(value.start, value.end - value.start);
+                document.setValue(path_list, QVariant::fromValue(PreEncoded(value_tns)),
+                            ok);
+            }
+        }
+        else {
+            qDebug() << "unknown delta operation: " << kind_bytes;
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        return QByteArray();
+    }
+    return document.save(ok);
+}
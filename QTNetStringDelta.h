@@ -0,0 +1,44 @@
+#ifndef __qtnetstring_delta_h__
+#define __qtnetstring_delta_h__
+
+
+#include "QByteArray"
+
+
+namespace QTNetString {
+
+    /**
+     * Compute the changes between two versions of a TNetString.
+     *
+     * The delta is itself a TNetString: a list of operations which
+     * are either ["set", path, value] or ["remove", path], where path
+     * is a list of map keys and list indexes. The comparison works on
+     * the encoded bytes, equal subtrees are recognized by comparing
+     * their bytes and values are copied into the delta as they are.
+     *
+     * Paths are handled as QStrings by Document, so map keys which
+     * can not be converted to a QString and back without changes
+     * never appear in a path. Changes below such keys replace the
+     * whole map containing them instead.
+     *
+     * sets ok to false and returns an empty QByteArray if one of the
+     * tnetstrings is not valid.
+     */
+    QByteArray diff(const QByteArray &from, const QByteArray &to, bool &ok);
+
+    /**
+     * Apply a delta created by diff to from and return the encoded
+     * new version.
+     *
+     * Only the containers on the changed paths are encoded again,
+     * everything else is copied from from.
+     *
+     * sets ok to false and returns an empty QByteArray if the delta
+     * is not valid or does not fit to from.
+     */
+    QByteArray patch(const QByteArray &from, const QByteArray &delta, bool &ok);
+
+}
+
+
+#endif
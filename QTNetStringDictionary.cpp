@@ -0,0 +1,464 @@
+#include "QTNetStringDictionary.h"
+#include "QTNetString.h"
+#include "QTNetStringSax.h"
+
+#include <QIODevice>
+#include <QMap>
+#include <QPair>
+#include <QDebug>
+
+#include <algorithm>
+
+
+using namespace QTNetString;
+
+/* strings shorter than this are never put into the dictionary */
+static const int DICTIONARY_MIN_SIZE = 3;
+/* bytes read from the device at once */
+static const int DICTIONARY_READ_SIZE = 64 * 1024;
+
+
+/**
+ * counts how often every string of the records of a block occurs
+ */
+class StringCounter : public Handler {
+public:
+    bool null() { return true; }
+    bool boolean(bool) { return true; }
+    bool integer(const char *, int) { return true; }
+    bool floating(const char *, int) { return true; }
+    bool beginList() { return true; }
+    bool endList() { return true; }
+    bool beginMap() { return true; }
+    bool endMap() { return true; }
+
+    bool string(const char *data, int size)
+    {
+        if (size >= DICTIONARY_MIN_SIZE) {
+            // only copy the string when it is seen the first time
+            QHash<QByteArray, int>::iterator iter = counts.find(
+                        QByteArray::fromRawData(data, size));
+            if (iter == counts.end()) {
+                counts.insert(QByteArray(data, size), 1);
+            }
+            else {
+                ++iter.value();
+            }
+        }
+        return true;
+    }
+
+    bool key(const char *data, int size)
+    {
+        return string(data, size);
+    }
+
+    QHash<QByteArray, int> counts;
+};
+
+
+/**
+ * re-encodes a record with the strings of the dictionary replaced
+ * by references
+ */
+class DictionaryEncoder : public Writer {
+public:
+    DictionaryEncoder(const QHash<QByteArray, int> &index)
+        : m_index(index)
+    {
+    }
+
+    bool string(const char *data, int size)
+    {
+        QByteArray replaced;
+        if (replace(data, size, replaced)) {
+            return Writer::string(replaced.constData(), replaced.size());
+        }
+        return Writer::string(data, size);
+    }
+
+    bool key(const char *data, int size)
+    {
+        QByteArray replaced;
+        if (replace(data, size, replaced)) {
+            return Writer::key(replaced.constData(), replaced.size());
+        }
+        return Writer::key(data, size);
+    }
+
+private:
+    bool replace(const char *data, int size, QByteArray &replaced)
+    {
+        QHash<QByteArray, int>::const_iterator iter = m_index.constFind(
+                    QByteArray::fromRawData(data, size));
+        if (iter != m_index.constEnd()) {
+            replaced = QByteArray(1, '\0') + QByteArray::number(iter.value());
+            return true;
+        }
+        if ((size > 0) && (data[0] == '\0')) {
+            replaced = QByteArray(1, '\0') + QByteArray(data, size);
+            return true;
+        }
+        return false;
+    }
+
+    const QHash<QByteArray, int> &m_index;
+};
+
+
+/**
+ * builds the QVariant of a record and resolves the references
+ * to the dictionary
+ */
+class DictionaryBuilder : public Handler {
+public:
+    DictionaryBuilder(const QList<QByteArray> &dictionary, QVector<QString> &keys)
+        : m_dictionary(dictionary), m_keys(keys)
+    {
+    }
+
+    QVariant value() const
+    {
+        return m_value;
+    }
+
+    bool null()
+    {
+        return add(QVariant());
+    }
+
+    bool boolean(bool value)
+    {
+        return add(QVariant(value));
+    }
+
+    bool integer(const char *data, int size)
+    {
+        QByteArray text = QByteArray::fromRawData(data, size);
+        bool ok;
+        qint64 value = text.toLongLong(&ok);
+        if (ok) {
+            return add(QVariant(value));
+        }
+        quint64 unsigned_value = text.toULongLong(&ok);
+        return ok && add(QVariant(unsigned_value));
+    }
+
+    bool floating(const char *data, int size)
+    {
+        bool ok;
+        double value = QByteArray::fromRawData(data, size).toDouble(&ok);
+        return ok && add(QVariant(value));
+    }
+
+    bool string(const char *data, int size)
+    {
+        int index;
+        if (!reference(data, size, index)) {
+            return false;
+        }
+        if (index >= 0) {
+            return add(QVariant(m_dictionary.at(index)));
+        }
+        return add(QVariant(unescape(data, size)));
+    }
+
+    bool beginList()
+    {
+        m_stack.append(Container());
+        m_stack.last().is_map = false;
+        return true;
+    }
+
+    bool endList()
+    {
+        Container container = m_stack.takeLast();
+        return add(QVariant(container.list));
+    }
+
+    bool beginMap()
+    {
+        m_stack.append(Container());
+        m_stack.last().is_map = true;
+        return true;
+    }
+
+    bool key(const char *data, int size)
+    {
+        int index;
+        if (!reference(data, size, index)) {
+            return false;
+        }
+        if (index >= 0) {
+            // keys are converted once per block
+            if (m_keys.at(index).isNull()) {
+                m_keys[index] = QVariant(m_dictionary.at(index)).toString();
+            }
+            m_stack.last().key = m_keys.at(index);
+        }
+        else {
+            m_stack.last().key = QVariant(unescape(data, size)).toString();
+        }
+        return true;
+    }
+
+    bool endMap()
+    {
+        Container container = m_stack.takeLast();
+        return add(QVariant(container.map));
+    }
+
+private:
+    struct Container {
+        bool is_map;
+        QList<QVariant> list;
+        QMap<QString, QVariant> map;
+        QString key;
+    };
+
+    bool add(const QVariant &value)
+    {
+        if (m_stack.isEmpty()) {
+            m_value = value;
+        }
+        else if (m_stack.last().is_map) {
+            m_stack.last().map.insert(m_stack.last().key, value);
+        }
+        else {
+            m_stack.last().list.append(value);
+        }
+        return true;
+    }
+
+    /**
+     * the dictionary index a string refers to, or -1 if it is
+     * a literal string
+     */
+    bool reference(const char *data, int size, int &index)
+    {
+        index = -1;
+        if ((size < 2) || (data[0] != '\0') || (data[1] == '\0')) {
+            return true;
+        }
+
+        bool ok;
+        index = QByteArray::fromRawData(data + 1, size - 1).toInt(&ok);
+        if (!ok || (index < 0) || (index >= m_dictionary.size())) {
+            qDebug() << "invalid dictionary reference";
+            return false;
+        }
+        return true;
+    }
+
+    QByteArray unescape(const char *data, int size)
+    {
+        if ((size > 1) && (data[0] == '\0')) {
+            return QByteArray(data + 1, size - 1);
+        }
+        return QByteArray(data, size);
+    }
+
+    const QList<QByteArray> &m_dictionary;
+    QVector<QString> &m_keys;
+    QList<Container> m_stack;
+    QVariant m_value;
+};
+
+
+/**
+ * order of the dictionary, the most frequent strings get the
+ * shortest references
+ */
+static bool
+more_frequent(const QPair<int, QByteArray> &a, const QPair<int, QByteArray> &b)
+{
+    return a.first > b.first;
+}
+
+
+DictionaryWriter::DictionaryWriter(QIODevice *device, int block_records, int block_bytes)
+    : m_device(device), m_block_records(block_records), m_block_bytes(block_bytes),
+      m_buffered_bytes(0)
+{
+}
+
+
+DictionaryWriter::~DictionaryWriter()
+{
+    flush();
+}
+
+
+void
+DictionaryWriter::write(const QVariant &value, bool &ok)
+{
+    QByteArray tns = dump(value, ok);
+    if (ok) {
+        writeTns(tns, ok);
+    }
+}
+
+
+void
+DictionaryWriter::writeTns(const QByteArray &tns, bool &ok)
+{
+    ok = true;
+    m_records.append(tns);
+    m_buffered_bytes += tns.size();
+
+    if ((m_records.size() >= m_block_records) || (m_buffered_bytes >= m_block_bytes)) {
+        ok = flush();
+    }
+}
+
+
+bool
+DictionaryWriter::flush()
+{
+    if (m_records.isEmpty()) {
+        return true;
+    }
+
+    bool ok = true;
+    StringCounter counter;
+    for (int i = 0; ok && (i < m_records.size()); ++i) {
+        qint64 tns_end_pos;
+        walk(m_records.at(i).constData(), m_records.at(i).size(), 0, tns_end_pos, counter, ok);
+    }
+    if (!ok) {
+        qDebug() << "could not encode the records of the block";
+        m_records.clear();
+        m_buffered_bytes = 0;
+        return false;
+    }
+
+    // only strings which get shorter by the replacement
+    QList<QPair<int, QByteArray> > candidates;
+    QHash<QByteArray, int>::const_iterator iter;
+    for (iter = counter.counts.constBegin(); iter != counter.counts.constEnd(); ++iter) {
+        if (iter.value() > 1) {
+            candidates.append(qMakePair(iter.value(), iter.key()));
+        }
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), more_frequent);
+
+    QHash<QByteArray, int> index;
+    QList<QVariant> dictionary;
+    for (int i = 0; i < candidates.size(); ++i) {
+        int reference_size = 1 + QByteArray::number(dictionary.size()).size();
+        if (candidates.at(i).second.size() > reference_size) {
+            index.insert(candidates.at(i).second, dictionary.size());
+            dictionary.append(candidates.at(i).second);
+        }
+    }
+
+    QByteArray payload = dump(QVariant(dictionary), ok);
+    DictionaryEncoder encoder(index);
+    for (int i = 0; ok && (i < m_records.size()); ++i) {
+        qint64 tns_end_pos;
+        encoder.clear();
+        walk(m_records.at(i).constData(), m_records.at(i).size(), 0, tns_end_pos, encoder, ok);
+        payload.append(encoder.tns());
+    }
+
+    m_records.clear();
+    m_buffered_bytes = 0;
+
+    if (!ok) {
+        qDebug() << "could not encode the records of the block";
+        return false;
+    }
+    if (payload.size() > TNS_MAX_SIZE) {
+        qDebug() << "block is too large for a tns, use less records per block";
+        return false;
+    }
+
+    QByteArray block = QByteArray::number(payload.size());
+    block.append(':');
+    block.append(payload);
+    block.append(']');
+    return m_device->write(block) == block.size();
+}
+
+
+DictionaryReader::DictionaryReader(QIODevice *device)
+    : m_device(device), m_device_at_end(false), m_pos(0), m_end(0)
+{
+}
+
+
+bool
+DictionaryReader::read_block(bool &ok)
+{
+    ok = true;
+
+    while (!m_decoder.nextFrame(m_block, ok)) {
+        if (!ok) {
+            return false;
+        }
+        if (m_device_at_end) {
+            if (m_decoder.bufferedBytes() > 0) {
+                qDebug() << "archive ends with an incomplete block";
+                ok = false;
+            }
+            return false;
+        }
+
+        QByteArray chunk = m_device->read(DICTIONARY_READ_SIZE);
+        if (chunk.isEmpty() && !m_device->waitForReadyRead(-1)) {
+            m_device_at_end = true;
+        }
+        m_decoder.feed(chunk);
+    }
+
+    Element block;
+    Element dictionary;
+    if (!elementAt(m_block, 0, m_block.size(), block, ok)
+                || (block.type != ']')
+                || !elementAt(m_block, block.pl_start, block.pl_end, dictionary, ok)) {
+        qDebug() << "archive block has no dictionary";
+        ok = false;
+        return false;
+    }
+
+    qint64 tns_end_pos;
+    QList<QVariant> entries = parse(m_block.constData(), dictionary.end, dictionary.start,
+                tns_end_pos, ok).toList();
+    if (!ok) {
+        return false;
+    }
+
+    m_dictionary.clear();
+    for (int i = 0; i < entries.size(); ++i) {
+        m_dictionary.append(entries.at(i).toByteArray());
+    }
+    m_keys = QVector<QString>(m_dictionary.size());
+    m_pos = dictionary.end;
+    m_end = block.pl_end;
+    return true;
+}
+
+
+bool
+DictionaryReader::next(QVariant &value, bool &ok)
+{
+    ok = true;
+
+    while (m_pos >= m_end) {
+        if (!read_block(ok)) {
+            return false;
+        }
+    }
+
+    DictionaryBuilder builder(m_dictionary, m_keys);
+    qint64 tns_end_pos;
+    walk(m_block.constData(), m_end, m_pos, tns_end_pos, builder, ok);
+    if (!ok) {
+        m_pos = m_end;
+        return false;
+    }
+
+    value = builder.value();
+    m_pos = tns_end_pos;
+    return true;
+}
@@ -0,0 +1,112 @@
+#ifndef __qtnetstring_dictionary_h__
+#define __qtnetstring_dictionary_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QList"
+#include "QHash"
+#include "QString"
+#include "QVector"
+
+#include "QTNetStringDecoder.h"
+
+
+class QIODevice;
+
+
+namespace QTNetString {
+
+    /**
+     * Archive format storing repeated strings only once per block of
+     * records.
+     *
+     * A block is a tns list. Its first element is the dictionary, a
+     * list of strings, followed by the records. Inside of the records
+     * a string starting with a 0 byte refers to a dictionary entry by
+     * the decimal index after the 0 byte. Strings which really start
+     * with a 0 byte are written with a second 0 byte in front. Map
+     * keys are replaced the same way as string values.
+     *
+     * So every block is a valid TNetString and the records keep
+     * their structure, only their strings have to be resolved.
+     */
+    class DictionaryWriter {
+    public:
+        /**
+         * a block is written after block_records records or when
+         * the buffered records exceed block_bytes.
+         */
+        DictionaryWriter(QIODevice *device, int block_records = 1024,
+                    int block_bytes = 16 * 1024 * 1024);
+        ~DictionaryWriter();
+
+        /**
+         * dump value and add it to the current block.
+         *
+         * sets ok to false if the value could not be dumped or the
+         * block could not be written.
+         */
+        void write(const QVariant &value, bool &ok);
+
+        /**
+         * the same for a record which is already encoded
+         */
+        void writeTns(const QByteArray &tns, bool &ok);
+
+        /**
+         * write the buffered records as a block. Returns false if the
+         * records could not be encoded or the device did not accept
+         * them.
+         */
+        bool flush();
+
+    private:
+        QIODevice *m_device;
+        int m_block_records;
+        int m_block_bytes;
+        int m_buffered_bytes;
+        QList<QByteArray> m_records;
+
+        Q_DISABLE_COPY(DictionaryWriter)
+    };
+
+    /**
+     * Reads the records of a dictionary encoded archive.
+     *
+     * Strings which refer to the dictionary are returned as copies of
+     * the QByteArray of the dictionary entry, so all occurences of a
+     * string within a block share one allocation.
+     */
+    class DictionaryReader {
+    public:
+        DictionaryReader(QIODevice *device);
+
+        /**
+         * read the next record and write it to value.
+         *
+         * returns false when the end of the archive is reached or an
+         * error occured. ok is set to false if the archive is not
+         * valid.
+         */
+        bool next(QVariant &value, bool &ok);
+
+    private:
+        bool read_block(bool &ok);
+
+        QIODevice *m_device;
+        Decoder m_decoder;
+        bool m_device_at_end;
+        QByteArray m_block;
+        qint64 m_pos;
+        qint64 m_end;
+        QList<QByteArray> m_dictionary;
+        QVector<QString> m_keys;
+
+        Q_DISABLE_COPY(DictionaryReader)
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,491 @@
+#include "QTNetStringDocument.h"
+#include "QTNetString.h"
+
+#include <QSet>
+#include <QDebug>
+
+
+using namespace QTNetString;
+
+
+/**
+ * Changes are stored in a QMap keyed by their path. Every element
+ * of the path is written as "<size>:<bytes>", so the keys of all
+ * changes below a path start with the key of that path and form a
+ * continuous range of the QMap.
+ */
+inline QByteArray
+component_key(const QByteArray &component)
+{
+    QByteArray key = QByteArray::number(component.size());
+    key.append(':');
+    key.append(component);
+    return key;
+}
+
+
+inline QByteArray
+component_bytes(const QString &component)
+{
+    return QVariant(component).toByteArray();
+}
+
+
+static QByteArray
+path_key(const QStringList &path, int depth)
+{
+    QByteArray key;
+    for (int i = 0; i < depth; ++i) {
+        key.append(component_key(component_bytes(path.at(i))));
+    }
+    return key;
+}
+
+
+/**
+ * the value of a PreEncoded which has been set, e.g. by patch(), is
+ * parsed before it is looked into
+ */
+inline QVariant
+decoded(const QVariant &value, bool &ok)
+{
+    if (value.userType() == qMetaTypeId<PreEncoded>()) {
+        return parse(value.value<PreEncoded>().tns(), ok);
+    }
+    return value;
+}
+
+
+static QVariant
+variant_get(QVariant value, const QStringList &path, int depth, bool &ok)
+{
+    for (int i = depth; ok && (i < path.size()); ++i) {
+        value = decoded(value, ok);
+        QVariant::Type type = value.type();
+        if ((type == QVariant::Map) || (type == QVariant::Hash)) {
+            QMap<QString, QVariant> map = value.toMap();
+            ok = map.contains(path.at(i));
+            value = map.value(path.at(i));
+        }
+        else if (type == QVariant::List) {
+            QList<QVariant> list = value.toList();
+            int index = path.at(i).toInt(&ok);
+            ok = ok && (index >= 0) && (index < list.size());
+            if (ok) {
+                value = list.at(index);
+            }
+        }
+        else {
+            ok = false;
+        }
+    }
+
+    if (!ok) {
+        value.clear();
+    }
+    return value;
+}
+
+
+/**
+ * apply a change to a value which has been set as a whole before
+ */
+static void
+variant_set(QVariant &value, const QStringList &path, int depth, bool remove,
+            const QVariant &new_value, bool &ok)
+{
+    if (depth == path.size()) {
+        value = new_value;
+        return;
+    }
+
+    const QString &component = path.at(depth);
+    bool last = (depth + 1) == path.size();
+    value = decoded(value, ok);
+    QVariant::Type type = value.type();
+
+    if ((type == QVariant::Map) || (type == QVariant::Hash)) {
+        QMap<QString, QVariant> map = value.toMap();
+        if (last && remove) {
+            ok = map.remove(component) > 0;
+        }
+        else if (last || map.contains(component)) {
+            variant_set(map[component], path, depth + 1, remove, new_value, ok);
+        }
+        else {
+            ok = false;
+        }
+        value = map;
+    }
+    else if (type == QVariant::List) {
+        QList<QVariant> list = value.toList();
+        int index = component.toInt(&ok);
+        if (ok && last && remove && (index >= 0) && (index < list.size())) {
+            list.removeAt(index);
+        }
+        else if (ok && last && !remove && (index == list.size())) {
+            list.append(new_value);
+        }
+        else if (ok && (index >= 0) && (index < list.size())) {
+            variant_set(list[index], path, depth + 1, remove, new_value, ok);
+        }
+        else {
+            ok = false;
+        }
+        value = list;
+    }
+    else {
+        ok = false;
+    }
+
+    if (!ok) {
+        qDebug() << "no value at path " << path.join("/");
+    }
+}
+
+
+Document::Document()
+{
+}
+
+
+Document::Document(const QByteArray &tnetstring)
+    : m_tns(tnetstring)
+{
+}
+
+
+QByteArray
+Document::tns() const
+{
+    return m_tns;
+}
+
+
+bool
+Document::isModified() const
+{
+    return !m_edits.isEmpty();
+}
+
+
+QVariant
+Document::value(const QStringList &path, bool &ok) const
+{
+    ok = true;
+
+    // a change of the value itself or of one of its parents
+    for (int depth = 0; depth <= path.size(); ++depth) {
+        QMap<QByteArray, Edit>::const_iterator iter = m_edits.constFind(path_key(path, depth));
+        if (iter != m_edits.constEnd()) {
+            if (iter.value().remove) {
+                ok = false;
+                return QVariant();
+            }
+            return variant_get(iter.value().value, path, depth, ok);
+        }
+    }
+
+    Element element;
+    if (!elementAt(m_tns, 0, m_tns.size(), element, ok)) {
+        return QVariant();
+    }
+    for (int depth = 0; depth < path.size(); ++depth) {
+        Element child;
+        if (!findChild(m_tns, element, component_bytes(path.at(depth)), child, ok)) {
+            ok = false;
+            return QVariant();
+        }
+        element = child;
+    }
+
+    // changes below the value
+    QByteArray tns = rewrite(path_key(path, path.size()), element.start, element.end, ok);
+    if (!ok) {
+        return QVariant();
+    }
+    return parse(tns, ok);
+}
+
+
+void
+Document::edit(const QStringList &path, const Edit &edit, bool &ok)
+{
+    ok = true;
+
+    // changes inside of a value which has been set or removed as
+    // a whole are applied to that value
+    for (int depth = 0; depth < path.size(); ++depth) {
+        QMap<QByteArray, Edit>::iterator iter = m_edits.find(path_key(path, depth));
+        if (iter != m_edits.end()) {
+            if (iter.value().remove) {
+                qDebug() << "no value at path " << path.join("/");
+                ok = false;
+                return;
+            }
+
+            // the value is only replaced if the change could be applied
+            QVariant value = iter.value().value;
+            variant_set(value, path, depth, edit.remove, edit.value, ok);
+            if (ok) {
+                iter.value().value = value;
+            }
+            return;
+        }
+    }
+
+    bool is_new = false;
+    check_path(path, edit.remove, is_new, ok);
+    if (!ok) {
+        qDebug() << "no value at path " << path.join("/");
+        return;
+    }
+
+    // the new change replaces all changes below it. Removing a value
+    // which has only been set before just forgets about it.
+    QByteArray key = path_key(path, path.size());
+    QMap<QByteArray, Edit>::iterator iter = m_edits.lowerBound(key);
+    while ((iter != m_edits.end()) && iter.key().startsWith(key)) {
+        iter = m_edits.erase(iter);
+    }
+    if (!(edit.remove && is_new)) {
+        m_edits.insert(key, edit);
+    }
+}
+
+
+/**
+ * Check that a change at path without changes of its parents can be
+ * saved: all parents have to exist in the original bytes, only the
+ * last element may name a new map key or the index right after the
+ * end of a list including the values appended to it. is_new is set
+ * if path is not part of the original bytes.
+ */
+void
+Document::check_path(const QStringList &path, bool remove, bool &is_new, bool &ok) const
+{
+    is_new = false;
+    if (path.isEmpty()) {
+        ok = !remove;
+        return;
+    }
+
+    Element parent;
+    if (!elementAt(m_tns, 0, m_tns.size(), parent, ok)) {
+        return;
+    }
+    for (int depth = 0; depth < (path.size() - 1); ++depth) {
+        Element child;
+        if (!findChild(m_tns, parent, component_bytes(path.at(depth)), child, ok)) {
+            ok = false;
+            return;
+        }
+        parent = child;
+    }
+
+    QByteArray parent_key = path_key(path, path.size() - 1);
+    QByteArray component = component_bytes(path.last());
+    QMap<QByteArray, Edit>::const_iterator before = m_edits.constFind(
+                parent_key + component_key(component));
+    bool was_set = (before != m_edits.constEnd()) && !before.value().remove;
+    bool was_removed = (before != m_edits.constEnd()) && before.value().remove;
+
+    Element child;
+    if (findChild(m_tns, parent, component, child, ok) || !ok) {
+        ok = ok && !(remove && was_removed);
+        return;
+    }
+    is_new = true;
+
+    if (parent.type == '}') {
+        ok = !remove || was_set;
+    }
+    else if (parent.type == ']') {
+        int size = 0;
+        int pos = parent.pl_start;
+        while (ok && (pos < parent.pl_end)
+                    && elementAt(m_tns, pos, parent.pl_end, child, ok)) {
+            pos = child.end;
+            ++size;
+        }
+
+        // appended values have to follow each other, so only the
+        // last one can be removed
+        bool is_index;
+        int index = component.toInt(&is_index);
+        ok = ok && is_index && (index >= size);
+        for (int i = size; ok && (i < index); ++i) {
+            QMap<QByteArray, Edit>::const_iterator appended = m_edits.constFind(
+                        parent_key + component_key(QByteArray::number(i)));
+            ok = (appended != m_edits.constEnd()) && !appended.value().remove;
+        }
+        if (ok && remove) {
+            ok = was_set && !m_edits.contains(
+                        parent_key + component_key(QByteArray::number(index + 1)));
+        }
+    }
+    else {
+        ok = false;
+    }
+}
+
+
+void
+Document::setValue(const QStringList &path, const QVariant &value, bool &ok)
+{
+    Edit change;
+    change.remove = false;
+    change.value = value;
+    edit(path, change, ok);
+}
+
+
+void
+Document::remove(const QStringList &path, bool &ok)
+{
+    Edit change;
+    change.remove = true;
+    edit(path, change, ok);
+}
+
+
+/**
+ * encode the tns between tns_start_pos and tns_end_pos with all
+ * changes whose key starts with prefix. Parts without changes are
+ * copied.
+ */
+QByteArray
+Document::rewrite(const QByteArray &prefix, int tns_start_pos, int tns_end_pos,
+            bool &ok) const
+{
+    QMap<QByteArray, Edit>::const_iterator iter = m_edits.lowerBound(prefix);
+    if ((iter == m_edits.constEnd()) || !iter.key().startsWith(prefix)) {
+        return m_tns.mid(tns_start_pos, tns_end_pos - tns_start_pos);
+    }
+    if (iter.key() == prefix) {
+        return dump(iter.value().value, ok);
+    }
+
+    Element element;
+    if (!elementAt(m_tns, tns_start_pos, tns_end_pos, element, ok)) {
+        return QByteArray();
+    }
+
+    QByteArray payload;
+    int pos = element.pl_start;
+
+    if (element.type == ']') {
+        int index = 0;
+        Element child;
+        while (ok && (pos < element.pl_end)
+                    && elementAt(m_tns, pos, element.pl_end, child, ok)) {
+            QByteArray child_prefix = prefix + component_key(QByteArray::number(index));
+            QMap<QByteArray, Edit>::const_iterator child_edit = m_edits.constFind(child_prefix);
+            if ((child_edit == m_edits.constEnd()) || !child_edit.value().remove) {
+                payload.append(rewrite(child_prefix, child.start, child.end, ok));
+            }
+            pos = child.end;
+            ++index;
+        }
+
+        // values set right after the end of the list are appended
+        while (ok) {
+            QMap<QByteArray, Edit>::const_iterator child_edit = m_edits.constFind(
+                        prefix + component_key(QByteArray::number(index)));
+            if ((child_edit == m_edits.constEnd()) || child_edit.value().remove) {
+                break;
+            }
+            payload.append(dump(child_edit.value().value, ok));
+            ++index;
+        }
+    }
+    else if (element.type == '}') {
+        QSet<QByteArray> keys;
+        Element key;
+        Element child;
+        while (ok && (pos < element.pl_end)
+                    && elementAt(m_tns, pos, element.pl_end, key, ok)
+                    && elementAt(m_tns, key.end, element.pl_end, child, ok)) {
+            QByteArray key_bytes = m_tns.mid(key.pl_start, key.pl_end - key.pl_start);
+            QByteArray child_prefix = prefix + component_key(key_bytes);
+            keys.insert(key_bytes);
+
+            QMap<QByteArray, Edit>::const_iterator child_edit = m_edits.constFind(child_prefix);
+            if ((child_edit == m_edits.constEnd()) || !child_edit.value().remove) {
+                payload.append(m_tns.constData() + key.start, key.end - key.start);
+                payload.append(rewrite(child_prefix, child.start, child.end, ok));
+            }
+            pos = child.end;
+        }
+
+        // values set for keys which do not exist yet are added
+        for (; ok && (iter != m_edits.constEnd()) && iter.key().startsWith(prefix); ++iter) {
+            QByteArray rest = iter.key().mid(prefix.size());
+            int colon_pos = rest.indexOf(':');
+            QByteArray key_bytes = rest.mid(colon_pos + 1);
+            if (iter.value().remove || (rest.left(colon_pos).toInt() != key_bytes.size())
+                        || keys.contains(key_bytes)) {
+                continue;
+            }
+
+            payload.append(dump(QVariant(key_bytes), ok));
+            if (ok) {
+                payload.append(dump(iter.value().value, ok));
+            }
+        }
+    }
+    else {
+        qDebug() << "changes inside of a value which is no container";
+        ok = false;
+    }
+
+    if (!ok) {
+        return QByteArray();
+    }
+
+    QByteArray tns = QByteArray::number(payload.size());
+    tns.append(':');
+    tns.append(payload);
+    tns.append(element.type);
+    return tns;
+}
+
+
+QByteArray
+Document::encode(bool &ok) const
+{
+    ok = true;
+    if (m_edits.isEmpty()) {
+        return m_tns;
+    }
+
+    QMap<QByteArray, Edit>::const_iterator root_edit = m_edits.constFind(QByteArray());
+    if (root_edit != m_edits.constEnd()) {
+        if (root_edit.value().remove) {
+            qDebug() << "the document itself can not be removed";
+            ok = false;
+            return QByteArray();
+        }
+        return dump(root_edit.value().value, ok);
+    }
+
+    int tns_end_pos;
+    if (!frame(m_tns, 0, tns_end_pos, ok)) {
+        qDebug() << "document is not a complete tns";
+        ok = false;
+        return QByteArray();
+    }
+    return rewrite(QByteArray(), 0, tns_end_pos, ok);
+}
+
+
+QByteArray
+Document::save(bool &ok)
+{
+    QByteArray tns = encode(ok);
+    if (ok) {
+        m_tns = tns;
+        m_edits.clear();
+    }
+    return tns;
+}
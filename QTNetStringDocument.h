@@ -0,0 +1,99 @@
+#ifndef __qtnetstring_document_h__
+#define __qtnetstring_document_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QStringList"
+#include "QMap"
+
+
+namespace QTNetString {
+
+    /**
+     * An encoded TNetString which can be modified without parsing
+     * and dumping it as a whole.
+     *
+     * Values are addressed by paths of map keys and list indexes
+     * (as decimal strings), an empty path is the whole document.
+     * Changes are recorded next to the original bytes. save() only
+     * encodes the containers on the paths to the changes, everything
+     * else is copied from the original bytes.
+     */
+    class Document {
+    public:
+        Document();
+        explicit Document(const QByteArray &tnetstring);
+
+        /**
+         * the bytes the document was created from or saved to last
+         */
+        QByteArray tns() const;
+
+        /**
+         * true if there are changes which have not been saved
+         */
+        bool isModified() const;
+
+        /**
+         * the current value at path, including unsaved changes.
+         *
+         * returns QVariant::Invalid and sets ok to false if there is
+         * no value at path.
+         */
+        QVariant value(const QStringList &path, bool &ok) const;
+
+        /**
+         * set the value at path. The last element of the path may
+         * name a new map key, or the index right after the end of
+         * a list to append to it.
+         *
+         * sets ok to false and leaves the document unchanged if a
+         * parent of path does not exist or is no container, if the
+         * last element names neither an existing value nor one of
+         * the above, or if path is below a removed value.
+         */
+        void setValue(const QStringList &path, const QVariant &value, bool &ok);
+
+        /**
+         * remove the map entry or list element at path. Later list
+         * elements keep their original indexes until saved.
+         *
+         * sets ok to false and leaves the document unchanged if
+         * there is no value at path, or if path is empty.
+         */
+        void remove(const QStringList &path, bool &ok);
+
+        /**
+         * encode the document including all changes, make the result
+         * the new tns() and forget the changes.
+         *
+         * sets ok to false in case of an error and returns an empty
+         * QByteArray, the document is not modified in this case.
+         */
+        QByteArray save(bool &ok);
+
+        /**
+         * the same as save() but keeps the changes
+         */
+        QByteArray encode(bool &ok) const;
+
+    private:
+        struct Edit {
+            bool remove;
+            QVariant value;
+        };
+
+        void edit(const QStringList &path, const Edit &edit, bool &ok);
+        void check_path(const QStringList &path, bool remove, bool &is_new, bool &ok) const;
+        QByteArray rewrite(const QByteArray &prefix, int tns_start_pos, int tns_end_pos,
+                    bool &ok) const;
+
+        QByteArray m_tns;
+        QMap<QByteArray, Edit> m_edits;
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,192 @@
+#include "QTNetStringEncoder.h"
+#include "QTNetString.h"
+
+#include <QDebug>
+
+#include <string.h>
+
+
+using namespace QTNetString;
+
+
+/**
+ * the encoded size of value. The payload sizes of all containers
+ * are appended to sizes in the order encode() visits them.
+ */
+static qint64
+encoded_size(const QVariant &value, QVector<int> &sizes, bool &ok)
+{
+    if (!isContainer(value)) {
+        return dump(value, ok).size();
+    }
+
+    int size_index = sizes.size();
+    sizes.append(0);
+
+    qint64 pl_size = 0;
+    if (value.type() == QVariant::List) {
+        QList<QVariant> list_value = value.toList();
+        for (int i = 0; ok && (i < list_value.size()); ++i) {
+            pl_size += encoded_size(list_value.at(i), sizes, ok);
+        }
+    }
+    else {
+        QMap<QString, QVariant> map_value = value.toMap();
+        QMap<QString, QVariant>::const_iterator iter = map_value.constBegin();
+        for (; ok && (iter != map_value.constEnd()); ++iter) {
+            pl_size += dump(QVariant(iter.key()), ok).size();
+            if (ok) {
+                pl_size += encoded_size(iter.value(), sizes, ok);
+            }
+        }
+    }
+
+    if (ok && (pl_size > TNS_MAX_SIZE)) {
+        qDebug() << "tns payload is too large: " << pl_size;
+        ok = false;
+    }
+    if (!ok) {
+        return 0;
+    }
+
+    sizes[size_index] = int(pl_size);
+    return QByteArray::number(pl_size).size() + 1 + pl_size + 1;
+}
+
+
+Encoder::Encoder()
+    : m_status(Error), m_started(false), m_size(0), m_next_size(0), m_pending_pos(0)
+{
+}
+
+
+void
+Encoder::setValue(const QVariant &value, bool &ok)
+{
+    m_value = value;
+    m_started = false;
+    m_sizes.clear();
+    m_next_size = 0;
+    m_stack.clear();
+    m_pending.clear();
+    m_pending_pos = 0;
+
+    ok = true;
+    m_size = encoded_size(value, m_sizes, ok);
+    m_status = ok ? NeedMoreSpace : Error;
+}
+
+
+qint64
+Encoder::size() const
+{
+    return m_size;
+}
+
+
+/**
+ * produce the beginning of value: a scalar completely, the size
+ * prefix of a container
+ */
+void
+Encoder::visit(const QVariant &value)
+{
+    bool ok;
+    if (!isContainer(value)) {
+        m_pending = dump(value, ok);
+        if (!ok) {
+            m_status = Error;
+        }
+        return;
+    }
+
+    Frame frame;
+    frame.is_map = (value.type() != QVariant::List);
+    frame.expect_key = true;
+    frame.index = 0;
+    if (frame.is_map) {
+        frame.map = value.toMap();
+    }
+    else {
+        frame.list = value.toList();
+    }
+    m_stack.append(frame);
+    m_stack.last().iter = m_stack.last().map.constBegin();
+
+    m_pending = QByteArray::number(m_sizes.at(m_next_size++));
+    m_pending.append(':');
+}
+
+
+/**
+ * produce the next piece of the innermost open container
+ */
+void
+Encoder::advance()
+{
+    Frame &frame = m_stack.last();
+
+    if (!frame.is_map) {
+        if (frame.index < frame.list.size()) {
+            // visit may append to the stack, so copy the element first
+            QVariant value = frame.list.at(frame.index++);
+            visit(value);
+        }
+        else {
+            m_pending = QByteArray(1, ']');
+            m_stack.removeLast();
+        }
+    }
+    else if (frame.expect_key) {
+        if (frame.iter != frame.map.constEnd()) {
+            bool ok;
+            m_pending = dump(QVariant(frame.iter.key()), ok);
+            frame.expect_key = false;
+        }
+        else {
+            m_pending = QByteArray(1, '}');
+            m_stack.removeLast();
+        }
+    }
+    else {
+        // visit may append to the stack, so step on first
+        QVariant value = frame.iter.value();
+        ++frame.iter;
+        frame.expect_key = true;
+        visit(value);
+    }
+}
+
+
+Encoder::Status
+Encoder::encode(char *buffer, int buffer_size, int &written)
+{
+    written = 0;
+
+    while (m_status == NeedMoreSpace) {
+        int count = qMin(buffer_size - written, m_pending.size() - m_pending_pos);
+        memcpy(buffer + written, m_pending.constData() + m_pending_pos, count);
+        written += count;
+        m_pending_pos += count;
+
+        if (m_pending_pos < m_pending.size()) {
+            // the buffer is full
+            return m_status;
+        }
+
+        m_pending.clear();
+        m_pending_pos = 0;
+
+        if (!m_started) {
+            m_started = true;
+            visit(m_value);
+        }
+        else if (!m_stack.isEmpty()) {
+            advance();
+        }
+        else {
+            m_status = Done;
+        }
+    }
+    return m_status;
+}
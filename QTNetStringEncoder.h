@@ -0,0 +1,85 @@
+#ifndef __qtnetstring_encoder_h__
+#define __qtnetstring_encoder_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QList"
+#include "QMap"
+#include "QVector"
+
+
+namespace QTNetString {
+
+    /**
+     * Encodes a value piece by piece into buffers provided by the
+     * caller, e.g. the free space of a non-blocking socket's send
+     * buffer, so the complete TNetString never has to be held in
+     * memory.
+     *
+     * setValue() computes the sizes of all lists and maps first, as
+     * they are needed for the size prefixes before the payloads.
+     * encode() then fills the buffer and returns NeedMoreSpace when it
+     * is full; the next call continues at the same byte.
+     *
+     * The value must not be changed while it is encoded.
+     */
+    class Encoder {
+    public:
+        enum Status {
+            Done,
+            NeedMoreSpace,
+            Error
+        };
+
+        Encoder();
+
+        /**
+         * start encoding value. Sets ok to false if value can not be
+         * dumped, encode() returns Error then.
+         */
+        void setValue(const QVariant &value, bool &ok);
+
+        /**
+         * the total number of bytes the value is encoded to
+         */
+        qint64 size() const;
+
+        /**
+         * write the next at most buffer_size bytes of the encoded
+         * value to buffer and the number of bytes written to
+         * written.
+         *
+         * returns NeedMoreSpace if the value did not fit into
+         * buffer, and Done once the last byte has been written.
+         */
+        Status encode(char *buffer, int buffer_size, int &written);
+
+    private:
+        struct Frame {
+            bool is_map;
+            bool expect_key;
+            int index;
+            QList<QVariant> list;
+            QMap<QString, QVariant> map;
+            QMap<QString, QVariant>::const_iterator iter;
+        };
+
+        void visit(const QVariant &value);
+        void advance();
+
+        QVariant m_value;
+        Status m_status;
+        bool m_started;
+        qint64 m_size;
+        QVector<int> m_sizes;
+        int m_next_size;
+        QList<Frame> m_stack;
+        QByteArray m_pending;
+        int m_pending_pos;
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,280 @@
+#include "QTNetStringFileReader.h"
+#include "QTNetString.h"
+
+#include <QFutureInterface>
+#include <QRunnable>
+#include <QMutexLocker>
+#include <QDebug>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+
+using namespace QTNetString;
+
+
+namespace QTNetString {
+
+    class ReadTask : public QRunnable {
+    public:
+        ReadTask(FileReader *reader, qint64 offset, int size)
+            : m_reader(reader), m_offset(offset), m_size(size)
+        {
+            m_interface.reportStarted();
+        }
+
+        QFuture<FileReader::Chunk> future()
+        {
+            return m_interface.future();
+        }
+
+        void run()
+        {
+            m_interface.reportResult(m_reader->read_at(m_offset, m_size));
+            m_interface.reportFinished();
+        }
+
+    private:
+        QFutureInterface<FileReader::Chunk> m_interface;
+        FileReader *m_reader;
+        qint64 m_offset;
+        int m_size;
+    };
+
+}
+
+
+FileReader::FileReader(const QString &file_name, int buffer_size, int max_in_flight)
+    : m_file(file_name), m_buffer_size(buffer_size), m_file_size(0), m_next_offset(0),
+      m_current_pos(0), m_records_pos(0), m_failed(false)
+{
+    m_pool.setMaxThreadCount(qMax(1, max_in_flight));
+}
+
+
+FileReader::~FileReader()
+{
+    while (!m_in_flight.isEmpty()) {
+        m_in_flight.dequeue().waitForFinished();
+    }
+}
+
+
+bool
+FileReader::open()
+{
+    if (!m_file.open(QIODevice::ReadOnly | QIODevice::Unbuffered)) {
+        qDebug() << "could not open " << m_file.fileName() << ": " << m_file.errorString();
+        return false;
+    }
+
+    m_file_size = m_file.size();
+    fill();
+    return true;
+}
+
+
+/**
+ * read size bytes at offset, runs in the thread pool
+ */
+FileReader::Chunk
+FileReader::read_at(qint64 offset, int size)
+{
+    Chunk chunk;
+    chunk.data.resize(size);
+    chunk.ok = true;
+
+#ifdef Q_OS_UNIX
+    int done = 0;
+    while (done < size) {
+        ssize_t count = ::pread(m_file.handle(), chunk.data.data() + done, size - done,
+                    offset + done);
+        if ((count < 0) && (errno == EINTR)) {
+            continue;
+        }
+        if (count <= 0) {
+            break;
+        }
+        done += int(count);
+    }
+    chunk.ok = (done == size);
+#else
+    QMutexLocker locker(&m_file_lock);
+    chunk.ok = m_file.seek(offset) && (m_file.read(chunk.data.data(), size) == size);
+#endif
+
+    if (!chunk.ok) {
+        qDebug() << "could not read " << m_file.fileName() << " at offset " << offset;
+        chunk.data.clear();
+    }
+    return chunk;
+}
+
+
+/**
+ * start reads until max_in_flight buffers are read ahead
+ */
+void
+FileReader::fill()
+{
+    while ((m_next_offset < m_file_size)
+                && (m_in_flight.size() < m_pool.maxThreadCount())) {
+        int size = int(qMin(qint64(m_buffer_size), m_file_size - m_next_offset));
+        ReadTask *task = new ReadTask(this, m_next_offset, size);
+        m_in_flight.enqueue(task->future());
+        m_pool.start(task);
+        m_next_offset += size;
+    }
+}
+
+
+/**
+ * A record crossing the end of a buffer is completed in m_pending
+ * from the head of the next buffer, using its size prefix to copy
+ * no more than the missing bytes, and handed out on its own. The
+ * rest of the next buffer is handed out without copying it.
+ */
+bool
+FileReader::nextBuffer(QByteArray &records, bool &ok)
+{
+    // the data after an error can not be framed anymore
+    ok = !m_failed;
+    if (m_failed) {
+        return false;
+    }
+
+    while (true) {
+        if (m_current_pos >= m_current.size()) {
+            if (m_in_flight.isEmpty()) {
+                if (!m_pending.isEmpty()) {
+                    qDebug() << m_file.fileName() << " ends with an incomplete record";
+                    m_pending.clear();
+                    m_failed = true;
+                    ok = false;
+                }
+                return false;
+            }
+
+            Chunk chunk = m_in_flight.dequeue().result();
+            fill();
+            if (!chunk.ok) {
+                m_failed = true;
+                ok = false;
+                return false;
+            }
+            m_current = chunk.data;
+            m_current_pos = 0;
+            continue;
+        }
+
+        const char *head = m_current.constData() + m_current_pos;
+        int available = m_current.size() - m_current_pos;
+
+        if (!m_pending.isEmpty()) {
+            int take = available;
+            int colon_pos = m_pending.indexOf(':');
+            if (colon_pos >= 0) {
+                qint64 record_size = colon_pos + 1 + m_pending.left(colon_pos).toLongLong() + 1;
+                take = int(qMin(qint64(available), record_size - m_pending.size()));
+            }
+            else {
+                // the size prefix itself is split, complete it first
+                int head_colon_pos = m_current.indexOf(':', m_current_pos);
+                if (head_colon_pos >= 0) {
+                    take = head_colon_pos - m_current_pos + 1;
+                }
+            }
+            m_pending.append(head, take);
+            m_current_pos += take;
+
+            qint64 tns_end_pos;
+            if (frame(m_pending.constData(), m_pending.size(), 0, tns_end_pos, ok)) {
+                records = m_pending;
+                m_pending.clear();
+                return true;
+            }
+            if (!ok) {
+                m_pending.clear();
+                m_failed = true;
+                return false;
+            }
+            continue;
+        }
+
+        qint64 pos = 0;
+        qint64 tns_end_pos;
+        while (frame(head, available, pos, tns_end_pos, ok)) {
+            pos = tns_end_pos;
+        }
+        if (!ok) {
+            m_failed = true;
+            return false;
+        }
+
+        m_pending = QByteArray(head + pos, available - int(pos));
+        m_current_pos = m_current.size();
+        if (pos == 0) {
+            // a record larger than the buffer, keep collecting
+            continue;
+        }
+
+        if (pos == m_current.size()) {
+            // a buffer holding only complete records is used as it is
+            records = m_current;
+        }
+        else {
+            records = QByteArray::fromRawData(head, int(pos));
+        }
+        return true;
+    }
+}
+
+
+bool
+FileReader::next_record(qint64 &tns_start_pos, qint64 &tns_end_pos, bool &ok)
+{
+    ok = true;
+    while (m_records_pos >= m_records.size()) {
+        m_records_pos = 0;
+        if (!nextBuffer(m_records, ok)) {
+            m_records.clear();
+            return false;
+        }
+    }
+
+    // the buffer only contains complete records
+    tns_start_pos = m_records_pos;
+    frame(m_records.constData(), m_records.size(), tns_start_pos, tns_end_pos, ok);
+    m_records_pos = tns_end_pos;
+    return true;
+}
+
+
+bool
+FileReader::nextFrame(QByteArray &tns, bool &ok)
+{
+    qint64 tns_start_pos;
+    qint64 tns_end_pos;
+    if (!next_record(tns_start_pos, tns_end_pos, ok)) {
+        return false;
+    }
+
+    tns = m_records.mid(int(tns_start_pos), int(tns_end_pos - tns_start_pos));
+    return true;
+}
+
+
+bool
+FileReader::next(QVariant &value, bool &ok)
+{
+    qint64 tns_start_pos;
+    qint64 tns_end_pos;
+    if (!next_record(tns_start_pos, tns_end_pos, ok)) {
+        return false;
+    }
+
+    value = parse(m_records.constData(), m_records.size(), tns_start_pos, tns_end_pos, ok);
+    return ok;
+}
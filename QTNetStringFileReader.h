@@ -0,0 +1,95 @@
+#ifndef __qtnetstring_filereader_h__
+#define __qtnetstring_filereader_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QFile"
+#include "QMutex"
+#include "QQueue"
+#include "QFuture"
+#include "QThreadPool"
+
+
+namespace QTNetString {
+
+    /**
+     * Reads the records of a file of concatenated TNetStrings with
+     * several large reads in flight, so parsing does not wait for
+     * the disk.
+     *
+     * Reads are issued with pread() from a private thread pool (on
+     * systems without pread they are serialized on a lock). A record
+     * crossing the end of a buffer is completed from the head of the
+     * next one and returned as a buffer of its own, so the buffers
+     * returned by nextBuffer() always hold complete records.
+     */
+    class FileReader {
+    public:
+        /**
+         * the file is read in pieces of buffer_size bytes, at most
+         * max_in_flight of them are read ahead.
+         */
+        FileReader(const QString &file_name, int buffer_size = 4 * 1024 * 1024,
+                    int max_in_flight = 4);
+        ~FileReader();
+
+        bool open();
+
+        /**
+         * the next piece of the file, containing only complete
+         * records. A record larger than buffer_size gets a buffer
+         * of its own.
+         *
+         * records may point into memory of the reader, it is only
+         * valid until the next call of nextBuffer().
+         *
+         * returns false at the end of the file or on errors. ok is
+         * set to false if the file could not be read or ends with an
+         * incomplete record, and stays false for all later calls.
+         */
+        bool nextBuffer(QByteArray &records, bool &ok);
+
+        /**
+         * the next record of the file, without parsing it
+         */
+        bool nextFrame(QByteArray &tns, bool &ok);
+
+        /**
+         * parse the next record of the file
+         */
+        bool next(QVariant &value, bool &ok);
+
+    private:
+        struct Chunk {
+            QByteArray data;
+            bool ok;
+        };
+
+        friend class ReadTask;
+
+        Chunk read_at(qint64 offset, int size);
+        void fill();
+        bool next_record(qint64 &tns_start_pos, qint64 &tns_end_pos, bool &ok);
+
+        QFile m_file;
+        QMutex m_file_lock;
+        int m_buffer_size;
+        qint64 m_file_size;
+        qint64 m_next_offset;
+        QThreadPool m_pool;
+        QQueue<QFuture<Chunk> > m_in_flight;
+        QByteArray m_current;
+        int m_current_pos;
+        QByteArray m_pending;
+        QByteArray m_records;
+        qint64 m_records_pos;
+        bool m_failed;
+
+        Q_DISABLE_COPY(FileReader)
+    };
+
+}
+
+
+#endif
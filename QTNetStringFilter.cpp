@@ -0,0 +1,283 @@
+#include "QTNetStringFilter.h"
+#include "QTNetString.h"
+
+#include <QFile>
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+#include <string.h>
+
+
+using namespace QTNetString;
+
+
+/* powers of ten which are exact as doubles */
+static const double EXACT_POWERS_OF_TEN[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+
+/**
+ * convert the payload of an integer or float element without copying
+ * it. Values with up to 15 significant digits and a small exponent
+ * are exact in a double, so a single multiplication or division
+ * gives the correctly rounded result. Everything else is left to
+ * QByteArray::toDouble.
+ */
+static double
+payload_number(const char *data, const Element &element, bool &ok)
+{
+    const char *start = data + element.pl_start;
+    const char *end = data + element.pl_end;
+    const char *pos = start;
+    bool negative = false;
+    bool fraction = false;
+    qint64 mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool fast = true;
+
+    if ((pos < end) && ((*pos == '-') || (*pos == '+'))) {
+        negative = (*pos == '-');
+        ++pos;
+    }
+    const char *digits_start = pos;
+    for (; pos < end; ++pos) {
+        if ((*pos == '.') && !fraction) {
+            fraction = true;
+            continue;
+        }
+        if ((*pos < '0') || (*pos > '9')) {
+            break;
+        }
+        if ((mantissa != 0) || (*pos != '0')) {
+            ++digits;
+        }
+        fast = fast && (digits <= 15);
+        if (fast) {
+            mantissa = (mantissa * 10) + (*pos - '0');
+            exponent -= fraction ? 1 : 0;
+        }
+    }
+
+    if (fast && (pos == end) && (pos - digits_start > (fraction ? 1 : 0))
+                && (exponent >= -22)) {
+        double value = double(mantissa) / EXACT_POWERS_OF_TEN[-exponent];
+        ok = true;
+        return negative ? -value : value;
+    }
+
+    return QByteArray(start, end - start).toDouble(&ok);
+}
+
+
+Filter::Filter()
+{
+}
+
+
+void
+Filter::add(Operator op, const QStringList &path, const QByteArray &operand,
+            double min, double max)
+{
+    Predicate predicate;
+    predicate.op = op;
+    for (int i = 0; i < path.size(); ++i) {
+        predicate.path.append(QVariant(path.at(i)).toByteArray());
+    }
+    predicate.operand = operand;
+    predicate.min = min;
+    predicate.max = max;
+    m_predicates.append(predicate);
+}
+
+
+void
+Filter::addExists(const QStringList &path)
+{
+    add(Exists, path, QByteArray(), 0.0, 0.0);
+}
+
+
+void
+Filter::addEquals(const QStringList &path, const QVariant &value, bool &ok)
+{
+    QByteArray tns = dump(value, ok);
+    if (ok) {
+        add(Equals, path, tns, 0.0, 0.0);
+    }
+}
+
+
+void
+Filter::addPrefix(const QStringList &path, const QByteArray &prefix)
+{
+    add(Prefix, path, prefix, 0.0, 0.0);
+}
+
+
+void
+Filter::addRange(const QStringList &path, double min, double max)
+{
+    add(Range, path, QByteArray(), min, max);
+}
+
+
+bool
+Filter::isEmpty() const
+{
+    return m_predicates.isEmpty();
+}
+
+
+void
+Filter::clear()
+{
+    m_predicates.clear();
+}
+
+
+bool
+Filter::matches(const QByteArray &record, bool &ok) const
+{
+    Element root;
+    if (!elementAt(record, 0, record.size(), root, ok)) {
+        return false;
+    }
+
+    const char *data = record.constData();
+    for (int i = 0; i < m_predicates.size(); ++i) {
+        const Predicate &predicate = m_predicates.at(i);
+
+        Element element = root;
+        for (int depth = 0; depth < predicate.path.size(); ++depth) {
+            Element child;
+            if (!findChild(record, element, predicate.path.at(depth), child, ok)) {
+                return false;
+            }
+            element = child;
+        }
+
+        int pl_size = element.pl_end - element.pl_start;
+        bool match = false;
+
+        switch (predicate.op) {
+            case Exists:
+                match = true;
+                break;
+            case Equals:
+                match = ((element.end - element.start) == predicate.operand.size())
+                            && (memcmp(data + element.start, predicate.operand.constData(),
+                                    predicate.operand.size()) == 0);
+                break;
+            case Prefix:
+                match = (element.type == ',') && (pl_size >= predicate.operand.size())
+                            && (memcmp(data + element.pl_start, predicate.operand.constData(),
+                                    predicate.operand.size()) == 0);
+                break;
+            case Range:
+                if ((element.type == '#') || (element.type == '^')) {
+                    bool is_number;
+                    double value = payload_number(data, element, is_number);
+                    match = is_number && (value >= predicate.min) && (value <= predicate.max);
+                }
+                break;
+        }
+
+        if (!match) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+Filter::ChunkResult
+Filter::scan_chunk(const char *data, qint64 chunk_start, qint64 chunk_end) const
+{
+    ChunkResult result;
+    result.ok = true;
+
+    // the same QByteArray is pointed at every record, so only its
+    // header is allocated once
+    QByteArray record;
+    qint64 pos = chunk_start;
+
+    while (result.ok && (pos < chunk_end)) {
+        qint64 tns_end_pos;
+        if (!frame(data, chunk_end, pos, tns_end_pos, result.ok)) {
+            if (result.ok) {
+                qDebug() << "data ends with an incomplete tns";
+                result.ok = false;
+            }
+            break;
+        }
+
+        record.setRawData(data + pos, uint(tns_end_pos - pos));
+        if (matches(record, result.ok)) {
+            result.positions.append(pos);
+        }
+        pos = tns_end_pos;
+    }
+    return result;
+}
+
+
+QVector<qint64>
+Filter::scan(const char *data, qint64 data_size, bool &ok, int thread_count) const
+{
+    if (thread_count <= 0) {
+        thread_count = QThread::idealThreadCount();
+    }
+
+    QList<qint64> cuts = splitRecords(data, data_size, thread_count);
+
+    QList<QFuture<ChunkResult> > chunks;
+    for (int i = 1; i < cuts.size(); ++i) {
+        chunks.append(QtConcurrent::run(this, &Filter::scan_chunk, data, cuts.at(i - 1),
+                    cuts.at(i)));
+    }
+
+    QVector<qint64> positions;
+    ok = true;
+    for (int i = 0; i < chunks.size(); ++i) {
+        ChunkResult result = chunks.at(i).result();
+        if (ok) {
+            positions += result.positions;
+            ok = result.ok;
+        }
+    }
+    return positions;
+}
+
+
+QVector<qint64>
+Filter::scanFile(const QString &file_name, bool &ok, int thread_count) const
+{
+    QFile file(file_name);
+    if (!file.open(QIODevice::ReadOnly)) {
+        qDebug() << "could not open " << file_name << ": " << file.errorString();
+        ok = false;
+        return QVector<qint64>();
+    }
+
+    ok = true;
+    if (file.size() == 0) {
+        return QVector<qint64>();
+    }
+
+    uchar *data = file.map(0, file.size());
+    if (!data) {
+        qDebug() << "could not map " << file_name << ": " << file.errorString();
+        ok = false;
+        return QVector<qint64>();
+    }
+
+    QVector<qint64> positions = scan(reinterpret_cast<const char *>(data), file.size(), ok,
+                thread_count);
+    file.unmap(data);
+    return positions;
+}
@@ -0,0 +1,117 @@
+#ifndef __qtnetstring_filter_h__
+#define __qtnetstring_filter_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QStringList"
+#include "QVector"
+#include "QList"
+#include "QString"
+
+
+namespace QTNetString {
+
+    /**
+     * Selects records from a stream of concatenated TNetString
+     * records by predicates on the values at key paths.
+     *
+     * The predicates are evaluated on the encoded bytes: the values
+     * are found by skipping over the other elements using their size
+     * prefixes and compared without parsing them into QVariants, so
+     * records which do not match are rejected without allocating
+     * memory.
+     *
+     * A record matches when all predicates match. Paths are lists of
+     * map keys and list indexes like for QTNetString::Document.
+     */
+    class Filter {
+    public:
+        Filter();
+
+        /**
+         * there is a value at path
+         */
+        void addExists(const QStringList &path);
+
+        /**
+         * the value at path is encoded exactly like value. Maps only
+         * compare equal when their entries are in the same order.
+         *
+         * sets ok to false if value can not be dumped, the predicate
+         * is not added then.
+         */
+        void addEquals(const QStringList &path, const QVariant &value, bool &ok);
+
+        /**
+         * the value at path is a string which starts with prefix
+         */
+        void addPrefix(const QStringList &path, const QByteArray &prefix);
+
+        /**
+         * the value at path is an integer or float between min and
+         * max, both inclusive.
+         */
+        void addRange(const QStringList &path, double min, double max);
+
+        bool isEmpty() const;
+        void clear();
+
+        /**
+         * true if the tns record matches all predicates. ok is set
+         * to false if the record is not a valid tns.
+         */
+        bool matches(const QByteArray &record, bool &ok) const;
+
+        /**
+         * the positions of all matching records in data.
+         *
+         * data is split into one chunk per thread at record boundaries
+         * and the chunks are filtered with QtConcurrent. thread_count 0
+         * uses QThread::idealThreadCount().
+         *
+         * sets ok to false if data contains something which is not a
+         * tns and returns the positions found before it.
+         */
+        QVector<qint64> scan(const char *data, qint64 data_size, bool &ok,
+                    int thread_count = 0) const;
+
+        /**
+         * the same as scan, for the records of a file which is mapped
+         * into memory instead of being read.
+         */
+        QVector<qint64> scanFile(const QString &file_name, bool &ok,
+                    int thread_count = 0) const;
+
+    private:
+        enum Operator {
+            Exists,
+            Equals,
+            Prefix,
+            Range
+        };
+
+        struct Predicate {
+            Operator op;
+            QList<QByteArray> path;
+            QByteArray operand;
+            double min;
+            double max;
+        };
+
+        struct ChunkResult {
+            QVector<qint64> positions;
+            bool ok;
+        };
+
+        void add(Operator op, const QStringList &path, const QByteArray &operand,
+                    double min, double max);
+        ChunkResult scan_chunk(const char *data, qint64 chunk_start, qint64 chunk_end) const;
+
+        QList<Predicate> m_predicates;
+    };
+
+}
+
+
+#endif
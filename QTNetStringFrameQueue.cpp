@@ -0,0 +1,122 @@
+#include "QTNetStringFrameQueue.h"
+#include "QTNetString.h"
+
+
+using namespace QTNetString;
+
+
+/**
+ * The producers push onto a singly linked stack with a compare and
+ * swap on m_top. The consumer detaches the whole stack at once and
+ * reverses it into m_pending, so there is no ABA problem and the
+ * consumer never competes with producers for single nodes.
+ */
+struct FrameQueue::Node {
+    QByteArray tns;
+    Node *next;
+};
+
+
+FrameQueue::FrameQueue()
+    : m_top(0)
+{
+}
+
+
+FrameQueue::~FrameQueue()
+{
+    Node *node = m_top.fetchAndStoreOrdered(0);
+    while (node) {
+        Node *next = node->next;
+        delete node;
+        node = next;
+    }
+}
+
+
+void
+FrameQueue::push(const QByteArray &tns)
+{
+    Node *node = new Node;
+    node->tns = tns;
+
+    Node *top;
+    do {
+        top = m_top.fetchAndAddOrdered(0);
+        node->next = top;
+    } while (!m_top.testAndSetOrdered(top, node));
+}
+
+
+void
+FrameQueue::push(const QVariant &value, bool &ok)
+{
+    QByteArray tns = dump(value, ok);
+    if (ok) {
+        push(tns);
+    }
+}
+
+
+/**
+ * move everything pushed since the last call to the end
+ * of m_pending
+ */
+void
+FrameQueue::collect()
+{
+    Node *node = m_top.fetchAndStoreOrdered(0);
+    if (!node) {
+        return;
+    }
+
+    QList<QByteArray> reversed;
+    while (node) {
+        Node *next = node->next;
+        reversed.prepend(node->tns);
+        delete node;
+        node = next;
+    }
+    m_pending.append(reversed);
+}
+
+
+QList<QByteArray>
+FrameQueue::takeAll()
+{
+    collect();
+
+    QList<QByteArray> frames;
+    frames.swap(m_pending);
+    return frames;
+}
+
+
+int
+FrameQueue::drain(QByteArray &batch, int max_bytes)
+{
+    if (m_pending.isEmpty()) {
+        collect();
+    }
+
+    int taken = 0;
+    int batch_bytes = 0;
+    while (!m_pending.isEmpty()) {
+        int frame_size = m_pending.first().size();
+        if (taken && (batch_bytes + frame_size > max_bytes)) {
+            break;
+        }
+        batch.append(m_pending.takeFirst());
+        batch_bytes += frame_size;
+        ++taken;
+    }
+    return taken;
+}
+
+
+bool
+FrameQueue::isEmpty()
+{
+    collect();
+    return m_pending.isEmpty();
+}
@@ -0,0 +1,71 @@
+#ifndef __qtnetstring_framequeue_h__
+#define __qtnetstring_framequeue_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QList"
+#include "QAtomicPointer"
+
+
+namespace QTNetString {
+
+    /**
+     * A lock-free queue of encoded TNetString frames to hand
+     * messages from many producer threads to a single consumer
+     * thread.
+     *
+     * push() may be called from any thread. takeAll(), drain() and
+     * isEmpty() must only be called from the consumer thread.
+     */
+    class FrameQueue {
+    public:
+        FrameQueue();
+        ~FrameQueue();
+
+        /**
+         * append an already encoded TNetString
+         */
+        void push(const QByteArray &tns);
+
+        /**
+         * dump value and append it to the queue.
+         *
+         * sets ok to false if the value could not be dumped and
+         * does not modify the queue in this case.
+         */
+        void push(const QVariant &value, bool &ok);
+
+        /**
+         * remove all queued frames and return them in the order
+         * they were pushed.
+         */
+        QList<QByteArray> takeAll();
+
+        /**
+         * remove queued frames and append them to batch so they
+         * can be written with a single call.
+         *
+         * Stops before the frame which would make batch grow by
+         * more than max_bytes, but always takes at least one frame.
+         * Returns the number of frames appended to batch.
+         */
+        int drain(QByteArray &batch, int max_bytes = 1 << 20);
+
+        bool isEmpty();
+
+    private:
+        struct Node;
+
+        void collect();
+
+        QAtomicPointer<Node> m_top;
+        QList<QByteArray> m_pending;
+
+        Q_DISABLE_COPY(FrameQueue)
+    };
+
+}
+
+
+#endif
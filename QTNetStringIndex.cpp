@@ -0,0 +1,198 @@
+#include "QTNetStringIndex.h"
+
+#include <QDebug>
+
+#include <algorithm>
+
+#include <string.h>
+
+
+using namespace QTNetString;
+
+
+IndexedContainer::IndexedContainer()
+    : m_start_pos(0), m_built(false)
+{
+}
+
+
+IndexedContainer::IndexedContainer(const QByteArray &tnetstring, int tns_start_pos)
+    : m_tns(tnetstring), m_start_pos(tns_start_pos), m_built(false)
+{
+}
+
+
+/**
+ * collect the offsets of all elements. For maps the offsets are the
+ * ones of the keys, the values follow right after them.
+ */
+bool
+IndexedContainer::build(bool &ok) const
+{
+    ok = true;
+    if (m_built) {
+        return true;
+    }
+
+    if (!QTNetString::elementAt(m_tns, m_start_pos, m_tns.size(), m_element, ok)) {
+        return false;
+    }
+    if ((m_element.type != ']') && (m_element.type != '}')) {
+        qDebug() << "tns is no container";
+        ok = false;
+        return false;
+    }
+
+    bool is_map = (m_element.type == '}');
+    Element child;
+    int pos = m_element.pl_start;
+    while (ok && (pos < m_element.pl_end)
+                && QTNetString::elementAt(m_tns, pos, m_element.pl_end, child, ok)) {
+        if (is_map) {
+            if (child.type != ',') {
+                qDebug() << "tns map keys are only allowed to be strings";
+                ok = false;
+                break;
+            }
+
+            KeyHash key_hash;
+            key_hash.hash = hash(m_tns.constData() + child.pl_start, child.pl_end - child.pl_start);
+            key_hash.entry = m_offsets.size();
+            m_key_hashes.append(key_hash);
+
+            // skip the value
+            Element value;
+            if (!QTNetString::elementAt(m_tns, child.end, m_element.pl_end, value, ok)) {
+                break;
+            }
+            m_offsets.append(pos);
+            pos = value.end;
+        }
+        else {
+            m_offsets.append(pos);
+            pos = child.end;
+        }
+    }
+
+    if (!ok) {
+        m_offsets.clear();
+        m_key_hashes.clear();
+        return false;
+    }
+
+    std::sort(m_key_hashes.begin(), m_key_hashes.end());
+    m_built = true;
+    return true;
+}
+
+
+bool
+IndexedContainer::isList() const
+{
+    bool ok;
+    return build(ok) && (m_element.type == ']');
+}
+
+
+bool
+IndexedContainer::isMap() const
+{
+    bool ok;
+    return build(ok) && (m_element.type == '}');
+}
+
+
+int
+IndexedContainer::size(bool &ok) const
+{
+    if (!build(ok)) {
+        return -1;
+    }
+    return m_offsets.size();
+}
+
+
+bool
+IndexedContainer::elementAt(int index, Element &element, bool &ok) const
+{
+    if (!build(ok)) {
+        return false;
+    }
+    if ((index < 0) || (index >= m_offsets.size())) {
+        qDebug() << "index out of range: " << index;
+        ok = false;
+        return false;
+    }
+
+    if (!QTNetString::elementAt(m_tns, m_offsets.at(index), m_element.pl_end, element, ok)) {
+        return false;
+    }
+    if (m_element.type == '}') {
+        return QTNetString::elementAt(m_tns, element.end, m_element.pl_end, element, ok);
+    }
+    return true;
+}
+
+
+bool
+IndexedContainer::find(const QByteArray &key, Element &element, bool &ok) const
+{
+    if (!build(ok)) {
+        return false;
+    }
+    if (m_element.type != '}') {
+        qDebug() << "tns is no map";
+        ok = false;
+        return false;
+    }
+
+    KeyHash wanted;
+    wanted.hash = hash(key.constData(), key.size());
+    wanted.entry = 0;
+
+    QVector<KeyHash>::const_iterator iter = std::lower_bound(m_key_hashes.constBegin(),
+                m_key_hashes.constEnd(), wanted);
+    for (; (iter != m_key_hashes.constEnd()) && (iter->hash == wanted.hash); ++iter) {
+        Element key_element;
+        if (!QTNetString::elementAt(m_tns, m_offsets.at(iter->entry), m_element.pl_end,
+                    key_element, ok)) {
+            return false;
+        }
+
+        // compare the bytes, the hashes may collide
+        int key_size = key_element.pl_end - key_element.pl_start;
+        if ((key_size == key.size())
+                    && (memcmp(m_tns.constData() + key_element.pl_start, key.constData(),
+                            key_size) == 0)) {
+            return QTNetString::elementAt(m_tns, key_element.end, m_element.pl_end, element, ok);
+        }
+    }
+    return false;
+}
+
+
+QVariant
+IndexedContainer::at(int index, bool &ok) const
+{
+    Element element;
+    if (!elementAt(index, element, ok)) {
+        return QVariant();
+    }
+
+    int tns_end_pos;
+    return parse(m_tns, element.start, tns_end_pos, ok);
+}
+
+
+QVariant
+IndexedContainer::value(const QByteArray &key, bool &ok) const
+{
+    Element element;
+    if (!find(key, element, ok)) {
+        ok = false;
+        return QVariant();
+    }
+
+    int tns_end_pos;
+    return parse(m_tns, element.start, tns_end_pos, ok);
+}
@@ -0,0 +1,92 @@
+#ifndef __qtnetstring_index_h__
+#define __qtnetstring_index_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QVector"
+
+#include "QTNetString.h"
+
+
+namespace QTNetString {
+
+    /**
+     * Random access to the elements of an encoded list or map
+     * without parsing the whole container.
+     *
+     * On first access a table with the offset of every element is
+     * built, and for maps a table of key hashes sorted for binary
+     * search. After that list elements are found in constant time and
+     * map keys in logarithmic time, only the requested element is
+     * parsed.
+     *
+     * The tables are built lazily from const methods, so an instance
+     * must not be used from several threads without locking.
+     */
+    class IndexedContainer {
+    public:
+        IndexedContainer();
+        explicit IndexedContainer(const QByteArray &tnetstring, int tns_start_pos = 0);
+
+        bool isList() const;
+        bool isMap() const;
+
+        /**
+         * number of elements of a list or entries of a map. Returns -1
+         * and sets ok to false if the tnetstring is not a valid
+         * container.
+         */
+        int size(bool &ok) const;
+
+        /**
+         * positions of the element at index of a list, or of the value
+         * of the entry at index of a map, in tnetstring.
+         */
+        bool elementAt(int index, Element &element, bool &ok) const;
+
+        /**
+         * positions of the value of key in a map.
+         *
+         * returns false if there is no such key, ok is set to false
+         * if the tnetstring is not a valid map.
+         */
+        bool find(const QByteArray &key, Element &element, bool &ok) const;
+
+        /**
+         * parse the element at index of a list, or the value of the
+         * entry at index of a map.
+         */
+        QVariant at(int index, bool &ok) const;
+
+        /**
+         * parse the value of key in a map. Returns QVariant::Invalid
+         * and sets ok to false if there is no such key.
+         */
+        QVariant value(const QByteArray &key, bool &ok) const;
+
+    private:
+        struct KeyHash {
+            quint64 hash;
+            int entry;
+
+            bool operator<(const KeyHash &other) const
+            {
+                return hash < other.hash;
+            }
+        };
+
+        bool build(bool &ok) const;
+
+        QByteArray m_tns;
+        int m_start_pos;
+        mutable bool m_built;
+        mutable Element m_element;
+        mutable QVector<int> m_offsets;
+        mutable QVector<KeyHash> m_key_hashes;
+    };
+
+}
+
+
+#endif
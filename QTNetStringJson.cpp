@@ -0,0 +1,693 @@
+#include "QTNetStringJson.h"
+#include "QTNetString.h"
+
+#include <QIODevice>
+#include <QDebug>
+
+#include <math.h>
+#include <string.h>
+
+
+using namespace QTNetString;
+
+/* collected json text is written to the device beyond this size */
+static const int JSON_FLUSH_SIZE = 64 * 1024;
+
+
+/**
+ * true if the text of a tns float can be copied into the json
+ * output as it is
+ */
+static bool
+is_json_number(const char *data, int size)
+{
+    int i = 0;
+    if ((i < size) && (data[i] == '-')) {
+        ++i;
+    }
+    int digits = i;
+    while ((i < size) && (data[i] >= '0') && (data[i] <= '9')) {
+        ++i;
+    }
+    if (i == digits) {
+        return false;
+    }
+    if ((i < size) && (data[i] == '.')) {
+        digits = ++i;
+        while ((i < size) && (data[i] >= '0') && (data[i] <= '9')) {
+            ++i;
+        }
+        if (i == digits) {
+            return false;
+        }
+    }
+    if ((i < size) && ((data[i] == 'e') || (data[i] == 'E'))) {
+        ++i;
+        if ((i < size) && ((data[i] == '+') || (data[i] == '-'))) {
+            ++i;
+        }
+        digits = i;
+        while ((i < size) && (data[i] >= '0') && (data[i] <= '9')) {
+            ++i;
+        }
+        if (i == digits) {
+            return false;
+        }
+    }
+    return i == size;
+}
+
+
+JsonWriter::JsonWriter(QIODevice *device)
+    : m_device(device), m_need_comma(false)
+{
+}
+
+
+JsonWriter::~JsonWriter()
+{
+    flush();
+}
+
+
+QByteArray
+JsonWriter::json() const
+{
+    return m_json;
+}
+
+
+bool
+JsonWriter::flush()
+{
+    if (!m_device || m_json.isEmpty()) {
+        return true;
+    }
+
+    bool ok = m_device->write(m_json) == m_json.size();
+    m_json.clear();
+    return ok;
+}
+
+
+/**
+ * called after every complete value
+ */
+bool
+JsonWriter::written()
+{
+    m_need_comma = true;
+    if (m_device && (m_json.size() >= JSON_FLUSH_SIZE)) {
+        return flush();
+    }
+    return true;
+}
+
+
+bool
+JsonWriter::separate()
+{
+    if (m_need_comma) {
+        m_json.append(',');
+        m_need_comma = false;
+    }
+    return true;
+}
+
+
+bool
+JsonWriter::newline()
+{
+    m_json.append('\n');
+    m_need_comma = false;
+    return true;
+}
+
+
+/**
+ * append a quoted and escaped string. Runs of characters which
+ * need no escaping are appended at once.
+ */
+void
+JsonWriter::append_string(const char *data, int size)
+{
+    static const char hex[] = "0123456789abcdef";
+
+    m_json.append('"');
+    int run_start = 0;
+    for (int i = 0; i < size; ++i) {
+        unsigned char c = data[i];
+        if ((c >= 0x20) && (c != '"') && (c != '\\')) {
+            continue;
+        }
+
+        m_json.append(data + run_start, i - run_start);
+        run_start = i + 1;
+        switch (c) {
+            case '"':
+                m_json.append("\\\"");
+                break;
+            case '\\':
+                m_json.append("\\\\");
+                break;
+            case '\n':
+                m_json.append("\\n");
+                break;
+            case '\r':
+                m_json.append("\\r");
+                break;
+            case '\t':
+                m_json.append("\\t");
+                break;
+            default:
+                m_json.append("\\u00");
+                m_json.append(hex[c >> 4]);
+                m_json.append(hex[c & 0xf]);
+        }
+    }
+    m_json.append(data + run_start, size - run_start);
+    m_json.append('"');
+}
+
+
+bool
+JsonWriter::null()
+{
+    separate();
+    m_json.append("null");
+    return written();
+}
+
+
+bool
+JsonWriter::boolean(bool value)
+{
+    separate();
+    m_json.append(value ? "true" : "false");
+    return written();
+}
+
+
+bool
+JsonWriter::integer(const char *data, int size)
+{
+    int sign_size = ((size > 0) && (data[0] == '-')) ? 1 : 0;
+    bool valid = size > sign_size;
+    for (int i = sign_size; valid && (i < size); ++i) {
+        valid = (data[i] >= '0') && (data[i] <= '9');
+    }
+    if (!valid) {
+        qDebug() << "invalid tns integer: " << QByteArray(data, size);
+        return false;
+    }
+
+    // json numbers have no leading zeros
+    int digits_pos = sign_size;
+    while ((digits_pos < (size - 1)) && (data[digits_pos] == '0')) {
+        ++digits_pos;
+    }
+
+    separate();
+    m_json.append(data, sign_size);
+    m_json.append(data + digits_pos, size - digits_pos);
+    return written();
+}
+
+
+bool
+JsonWriter::floating(const char *data, int size)
+{
+    bool ok;
+    double value = QByteArray::fromRawData(data, size).toDouble(&ok);
+    if (!ok) {
+        qDebug() << "invalid tns float: " << QByteArray(data, size);
+        return false;
+    }
+
+    separate();
+    if ((value != value) || (fabs(value) > 1.7976931348623157e308)) {
+        m_json.append("null");
+    }
+    else if (is_json_number(data, size)) {
+        m_json.append(data, size);
+    }
+    else {
+        m_json.append(QByteArray::number(value, 'g', 17));
+    }
+    return written();
+}
+
+
+bool
+JsonWriter::string(const char *data, int size)
+{
+    separate();
+    append_string(data, size);
+    return written();
+}
+
+
+bool
+JsonWriter::beginList()
+{
+    separate();
+    m_json.append('[');
+    return true;
+}
+
+
+bool
+JsonWriter::endList()
+{
+    m_json.append(']');
+    return written();
+}
+
+
+bool
+JsonWriter::beginMap()
+{
+    separate();
+    m_json.append('{');
+    return true;
+}
+
+
+bool
+JsonWriter::key(const char *data, int size)
+{
+    separate();
+    append_string(data, size);
+    m_json.append(':');
+    return true;
+}
+
+
+bool
+JsonWriter::endMap()
+{
+    m_json.append('}');
+    return written();
+}
+
+
+QByteArray
+QTNetString::toJson(const QByteArray &tnetstring, bool &ok)
+{
+    JsonWriter writer;
+    qint64 tns_end_pos;
+
+    walk(tnetstring.constData(), tnetstring.size(), 0, tns_end_pos, writer, ok);
+    if (!ok) {
+        return QByteArray();
+    }
+    return writer.json();
+}
+
+
+void
+QTNetString::toJson(const char *data, qint64 data_size, QIODevice *device, bool &ok)
+{
+    JsonWriter writer(device);
+    qint64 pos = 0;
+
+    ok = true;
+    while (ok && (pos < data_size)) {
+        walk(data, data_size, pos, pos, writer, ok);
+        if (ok) {
+            writer.newline();
+        }
+    }
+
+    if (!writer.flush()) {
+        qDebug() << "could not write json to device";
+        ok = false;
+    }
+}
+
+
+/**
+ * recursive descent parser for json text, see http://json.org
+ */
+class JsonReader {
+public:
+    JsonReader(const QByteArray &json, Handler &handler)
+        : m_pos(json.constData()), m_end(json.constData() + json.size()),
+          m_handler(handler), m_depth(0)
+    {
+    }
+
+    bool document()
+    {
+        if (!value()) {
+            return false;
+        }
+        skip_whitespace();
+        if (m_pos != m_end) {
+            qDebug() << "trailing characters after json value";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    void skip_whitespace()
+    {
+        while ((m_pos < m_end)
+                    && ((*m_pos == ' ') || (*m_pos == '\t') || (*m_pos == '\n') || (*m_pos == '\r'))) {
+            ++m_pos;
+        }
+    }
+
+    bool literal(const char *text, int size)
+    {
+        if (((m_end - m_pos) < size) || (memcmp(m_pos, text, size) != 0)) {
+            qDebug() << "invalid json literal";
+            return false;
+        }
+        m_pos += size;
+        return true;
+    }
+
+    static int hex_digit(char c)
+    {
+        if ((c >= '0') && (c <= '9')) {
+            return c - '0';
+        }
+        if ((c >= 'a') && (c <= 'f')) {
+            return c - 'a' + 10;
+        }
+        if ((c >= 'A') && (c <= 'F')) {
+            return c - 'A' + 10;
+        }
+        return -1;
+    }
+
+    bool read_hex4(uint &code)
+    {
+        if ((m_end - m_pos) < 4) {
+            return false;
+        }
+        code = 0;
+        for (int i = 0; i < 4; ++i) {
+            int digit = hex_digit(*m_pos++);
+            if (digit < 0) {
+                return false;
+            }
+            code = (code << 4) | digit;
+        }
+        return true;
+    }
+
+    static void append_utf8(QByteArray &out, uint code)
+    {
+        if (code < 0x80) {
+            out.append(char(code));
+        }
+        else if (code < 0x800) {
+            out.append(char(0xc0 | (code >> 6)));
+            out.append(char(0x80 | (code & 0x3f)));
+        }
+        else if (code < 0x10000) {
+            out.append(char(0xe0 | (code >> 12)));
+            out.append(char(0x80 | ((code >> 6) & 0x3f)));
+            out.append(char(0x80 | (code & 0x3f)));
+        }
+        else {
+            out.append(char(0xf0 | (code >> 18)));
+            out.append(char(0x80 | ((code >> 12) & 0x3f)));
+            out.append(char(0x80 | ((code >> 6) & 0x3f)));
+            out.append(char(0x80 | (code & 0x3f)));
+        }
+    }
+
+    /**
+     * read a string starting at the opening quote. Strings without
+     * escapes are handed to the handler without copying them.
+     */
+    bool string(bool is_key)
+    {
+        const char *start = ++m_pos;
+        while ((m_pos < m_end) && (*m_pos != '"') && (*m_pos != '\\')) {
+            ++m_pos;
+        }
+        if (m_pos >= m_end) {
+            qDebug() << "unterminated json string";
+            return false;
+        }
+
+        if (*m_pos == '"') {
+            int size = int(m_pos++ - start);
+            return is_key ? m_handler.key(start, size) : m_handler.string(start, size);
+        }
+
+        QByteArray unescaped(start, int(m_pos - start));
+        while ((m_pos < m_end) && (*m_pos != '"')) {
+            if (*m_pos != '\\') {
+                unescaped.append(*m_pos++);
+                continue;
+            }
+
+            if (++m_pos >= m_end) {
+                break;
+            }
+            char escaped = *m_pos++;
+            switch (escaped) {
+                case '"':
+                case '\\':
+                case '/':
+                    unescaped.append(escaped);
+                    break;
+                case 'b':
+                    unescaped.append('\b');
+                    break;
+                case 'f':
+                    unescaped.append('\f');
+                    break;
+                case 'n':
+                    unescaped.append('\n');
+                    break;
+                case 'r':
+                    unescaped.append('\r');
+                    break;
+                case 't':
+                    unescaped.append('\t');
+                    break;
+                case 'u': {
+                    uint code;
+                    if (!read_hex4(code)) {
+                        qDebug() << "invalid json unicode escape";
+                        return false;
+                    }
+                    // combine surrogate pairs
+                    if ((code >= 0xd800) && (code < 0xdc00) && ((m_end - m_pos) >= 6)
+                                && (m_pos[0] == '\\') && (m_pos[1] == 'u')) {
+                        const char *low_start = m_pos;
+                        m_pos += 2;
+                        uint low;
+                        if (read_hex4(low) && (low >= 0xdc00) && (low < 0xe000)) {
+                            code = 0x10000 + ((code - 0xd800) << 10) + (low - 0xdc00);
+                        }
+                        else {
+                            m_pos = low_start;
+                        }
+                    }
+                    append_utf8(unescaped, code);
+                    break;
+                }
+                default:
+                    qDebug() << "invalid json escape: " << escaped;
+                    return false;
+            }
+        }
+
+        if (m_pos >= m_end) {
+            qDebug() << "unterminated json string";
+            return false;
+        }
+        ++m_pos;
+        return is_key ? m_handler.key(unescaped.constData(), unescaped.size())
+                    : m_handler.string(unescaped.constData(), unescaped.size());
+    }
+
+    bool number()
+    {
+        const char *start = m_pos;
+        bool is_float = false;
+
+        if ((m_pos < m_end) && (*m_pos == '-')) {
+            ++m_pos;
+        }
+        const char *digits = m_pos;
+        while ((m_pos < m_end) && (*m_pos >= '0') && (*m_pos <= '9')) {
+            ++m_pos;
+        }
+        if (m_pos == digits) {
+            qDebug() << "invalid json number";
+            return false;
+        }
+        if ((m_pos < m_end) && (*m_pos == '.')) {
+            is_float = true;
+            ++m_pos;
+            while ((m_pos < m_end) && (*m_pos >= '0') && (*m_pos <= '9')) {
+                ++m_pos;
+            }
+        }
+        if ((m_pos < m_end) && ((*m_pos == 'e') || (*m_pos == 'E'))) {
+            is_float = true;
+            ++m_pos;
+            if ((m_pos < m_end) && ((*m_pos == '+') || (*m_pos == '-'))) {
+                ++m_pos;
+            }
+            while ((m_pos < m_end) && (*m_pos >= '0') && (*m_pos <= '9')) {
+                ++m_pos;
+            }
+        }
+
+        int size = int(m_pos - start);
+        return is_float ? m_handler.floating(start, size) : m_handler.integer(start, size);
+    }
+
+    bool list()
+    {
+        ++m_pos;
+        if (!m_handler.beginList()) {
+            return false;
+        }
+
+        skip_whitespace();
+        if ((m_pos < m_end) && (*m_pos == ']')) {
+            ++m_pos;
+            return m_handler.endList();
+        }
+
+        while (true) {
+            if (!value()) {
+                return false;
+            }
+            skip_whitespace();
+            if (m_pos >= m_end) {
+                break;
+            }
+            if (*m_pos == ',') {
+                ++m_pos;
+                continue;
+            }
+            if (*m_pos == ']') {
+                ++m_pos;
+                return m_handler.endList();
+            }
+            break;
+        }
+
+        qDebug() << "invalid json array";
+        return false;
+    }
+
+    bool map()
+    {
+        ++m_pos;
+        if (!m_handler.beginMap()) {
+            return false;
+        }
+
+        skip_whitespace();
+        if ((m_pos < m_end) && (*m_pos == '}')) {
+            ++m_pos;
+            return m_handler.endMap();
+        }
+
+        while (true) {
+            skip_whitespace();
+            if ((m_pos >= m_end) || (*m_pos != '"')) {
+                break;
+            }
+            if (!string(true)) {
+                return false;
+            }
+            skip_whitespace();
+            if ((m_pos >= m_end) || (*m_pos != ':')) {
+                break;
+            }
+            ++m_pos;
+            if (!value()) {
+                return false;
+            }
+            skip_whitespace();
+            if (m_pos >= m_end) {
+                break;
+            }
+            if (*m_pos == ',') {
+                ++m_pos;
+                continue;
+            }
+            if (*m_pos == '}') {
+                ++m_pos;
+                return m_handler.endMap();
+            }
+            break;
+        }
+
+        qDebug() << "invalid json object";
+        return false;
+    }
+
+    bool value()
+    {
+        skip_whitespace();
+        if (m_pos >= m_end) {
+            qDebug() << "unexpected end of json";
+            return false;
+        }
+
+        switch (*m_pos) {
+            case '{':
+            case '[': {
+                if (m_depth >= MAX_NESTING_DEPTH) {
+                    qDebug() << "json is nested too deeply";
+                    return false;
+                }
+                ++m_depth;
+                bool result = (*m_pos == '{') ? map() : list();
+                --m_depth;
+                return result;
+            }
+            case '"':
+                return string(false);
+            case 't':
+                return literal("true", 4) && m_handler.boolean(true);
+            case 'f':
+                return literal("false", 5) && m_handler.boolean(false);
+            case 'n':
+                return literal("null", 4) && m_handler.null();
+            default:
+                return number();
+        }
+    }
+
+    const char *m_pos;
+    const char *m_end;
+    Handler &m_handler;
+    int m_depth;
+};
+
+
+void
+QTNetString::readJson(const QByteArray &json, Handler &handler, bool &ok)
+{
+    JsonReader reader(json, handler);
+    ok = reader.document();
+}
+
+
+QByteArray
+QTNetString::fromJson(const QByteArray &json, bool &ok)
+{
+    Writer writer;
+
+    readJson(json, writer, ok);
+    if (!ok) {
+        return QByteArray();
+    }
+    return writer.tns();
+}
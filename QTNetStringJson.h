@@ -0,0 +1,102 @@
+#ifndef __qtnetstring_json_h__
+#define __qtnetstring_json_h__
+
+
+#include "QByteArray"
+
+#include "QTNetStringSax.h"
+
+
+class QIODevice;
+
+
+namespace QTNetString {
+
+    /**
+     * Convert a TNetString to JSON text without building a QVariant
+     * structure in between.
+     *
+     * Strings are copied as they are, so they should contain UTF-8.
+     * Floats which have no JSON representation (nan, inf) become null.
+     *
+     * sets ok to false and returns an empty QByteArray if the
+     * tnetstring is not valid.
+     */
+    QByteArray toJson(const QByteArray &tnetstring, bool &ok);
+
+    /**
+     * Convert all concatenated TNetStrings in data to JSON and write
+     * them to device, one JSON document per line.
+     *
+     * The output is written in pieces while walking the input, so the
+     * memory used does not depend on the size of data.
+     */
+    void toJson(const char *data, qint64 data_size, QIODevice *device, bool &ok);
+
+    /**
+     * Convert JSON text to a TNetString without building a QVariant
+     * structure in between.
+     *
+     * sets ok to false and returns an empty QByteArray if the
+     * json is not valid or nested deeper than MAX_NESTING_DEPTH.
+     */
+    QByteArray fromJson(const QByteArray &json, bool &ok);
+
+    /**
+     * Report the contents of a JSON document to handler in the same
+     * way walk() reports the contents of a TNetString.
+     */
+    void readJson(const QByteArray &json, Handler &handler, bool &ok);
+
+    /**
+     * A handler which writes the events it receives as JSON text.
+     *
+     * Without a device the text is collected and returned by json().
+     * With a device it is written to the device whenever a few
+     * kilobytes have been collected and on flush().
+     */
+    class JsonWriter : public Handler {
+    public:
+        JsonWriter(QIODevice *device = 0);
+        ~JsonWriter();
+
+        QByteArray json() const;
+
+        /**
+         * write the collected text to the device. Returns false
+         * if the device did not accept it.
+         */
+        bool flush();
+
+        /**
+         * start the next top level value on a new line
+         */
+        bool newline();
+
+        bool null();
+        bool boolean(bool value);
+        bool integer(const char *data, int size);
+        bool floating(const char *data, int size);
+        bool string(const char *data, int size);
+
+        bool beginList();
+        bool endList();
+
+        bool beginMap();
+        bool key(const char *data, int size);
+        bool endMap();
+
+    private:
+        bool separate();
+        void append_string(const char *data, int size);
+        bool written();
+
+        QIODevice *m_device;
+        QByteArray m_json;
+        bool m_need_comma;
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,554 @@
+#include "QTNetStringMsgPack.h"
+#include "QTNetString.h"
+
+#include <QDebug>
+
+#include <string.h>
+
+
+using namespace QTNetString;
+
+
+/**
+ * append value as a big endian integer of the given number of bytes
+ */
+inline void
+msgpack_append_be(QByteArray &out, quint64 value, int bytes)
+{
+    for (int shift = (bytes - 1) * 8; shift >= 0; shift -= 8) {
+        out.append(char(value >> shift));
+    }
+}
+
+
+/**
+ * append the header of a str of the given length
+ */
+inline void
+msgpack_append_str(QByteArray &out, quint32 length)
+{
+    if (length <= 31) {
+        out.append(char(0xa0 | length));
+    }
+    else if (length <= 0xff) {
+        out.append(char(0xd9));
+        msgpack_append_be(out, length, 1);
+    }
+    else if (length <= 0xffff) {
+        out.append(char(0xda));
+        msgpack_append_be(out, length, 2);
+    }
+    else {
+        out.append(char(0xdb));
+        msgpack_append_be(out, length, 4);
+    }
+}
+
+
+/**
+ * append the header of a bin of the given length
+ */
+inline void
+msgpack_append_bin(QByteArray &out, quint32 length)
+{
+    if (length <= 0xff) {
+        out.append(char(0xc4));
+        msgpack_append_be(out, length, 1);
+    }
+    else if (length <= 0xffff) {
+        out.append(char(0xc5));
+        msgpack_append_be(out, length, 2);
+    }
+    else {
+        out.append(char(0xc6));
+        msgpack_append_be(out, length, 4);
+    }
+}
+
+
+/**
+ * append a tns string. tns strings are bytes, only valid UTF-8 is
+ * written as str, everything else as bin.
+ */
+inline void
+msgpack_append_string(QByteArray &out, const char *data, int size)
+{
+    if (isUtf8(data, size)) {
+        msgpack_append_str(out, size);
+    }
+    else {
+        msgpack_append_bin(out, size);
+    }
+    out.append(data, size);
+}
+
+
+/**
+ * append the header of an array or map. fix_marker is the marker
+ * of the fixarray/fixmap form, marker16 the one of the 16 bit form
+ * which is followed by the 32 bit form.
+ */
+inline void
+msgpack_append_container(QByteArray &out, quint32 count, uchar fix_marker, uchar marker16)
+{
+    if (count <= 15) {
+        out.append(char(fix_marker | count));
+    }
+    else if (count <= 0xffff) {
+        out.append(char(marker16));
+        msgpack_append_be(out, count, 2);
+    }
+    else {
+        out.append(char(marker16 + 1));
+        msgpack_append_be(out, count, 4);
+    }
+}
+
+
+MsgPackWriter::MsgPackWriter()
+{
+}
+
+
+QByteArray
+MsgPackWriter::msgpack() const
+{
+    return m_msgpack;
+}
+
+
+/**
+ * the buffer of the innermost open container, or the result if
+ * there is none
+ */
+QByteArray &
+MsgPackWriter::out()
+{
+    return m_payloads.isEmpty() ? m_msgpack : m_payloads.last();
+}
+
+
+/**
+ * count a value in the innermost open container
+ */
+void
+MsgPackWriter::counted()
+{
+    if (!m_counts.isEmpty()) {
+        ++m_counts.last();
+    }
+}
+
+
+bool
+MsgPackWriter::null()
+{
+    out().append(char(0xc0));
+    counted();
+    return true;
+}
+
+
+bool
+MsgPackWriter::boolean(bool value)
+{
+    out().append(char(value ? 0xc3 : 0xc2));
+    counted();
+    return true;
+}
+
+
+bool
+MsgPackWriter::integer(const char *data, int size)
+{
+    QByteArray text = QByteArray::fromRawData(data, size);
+    QByteArray &buffer = out();
+    bool ok;
+
+    qint64 value = text.toLongLong(&ok);
+    if (ok) {
+        if ((value >= 0) && (value <= 0x7f)) {
+            buffer.append(char(value));
+        }
+        else if ((value < 0) && (value >= -32)) {
+            buffer.append(char(value));
+        }
+        else if (value >= 0) {
+            quint64 unsigned_value = quint64(value);
+            if (unsigned_value <= 0xff) {
+                buffer.append(char(0xcc));
+                msgpack_append_be(buffer, unsigned_value, 1);
+            }
+            else if (unsigned_value <= 0xffff) {
+                buffer.append(char(0xcd));
+                msgpack_append_be(buffer, unsigned_value, 2);
+            }
+            else if (unsigned_value <= 0xffffffffULL) {
+                buffer.append(char(0xce));
+                msgpack_append_be(buffer, unsigned_value, 4);
+            }
+            else {
+                buffer.append(char(0xcf));
+                msgpack_append_be(buffer, unsigned_value, 8);
+            }
+        }
+        else if (value >= -128) {
+            buffer.append(char(0xd0));
+            msgpack_append_be(buffer, quint64(value), 1);
+        }
+        else if (value >= -32768) {
+            buffer.append(char(0xd1));
+            msgpack_append_be(buffer, quint64(value), 2);
+        }
+        else if (value >= -2147483647LL - 1) {
+            buffer.append(char(0xd2));
+            msgpack_append_be(buffer, quint64(value), 4);
+        }
+        else {
+            buffer.append(char(0xd3));
+            msgpack_append_be(buffer, quint64(value), 8);
+        }
+        counted();
+        return true;
+    }
+
+    quint64 unsigned_value = text.toULongLong(&ok);
+    if (ok) {
+        buffer.append(char(0xcf));
+        msgpack_append_be(buffer, unsigned_value, 8);
+        counted();
+        return true;
+    }
+
+    qDebug() << "tns integer does not fit into 64 bit: " << text;
+    return false;
+}
+
+
+bool
+MsgPackWriter::floating(const char *data, int size)
+{
+    bool ok;
+    double value = QByteArray::fromRawData(data, size).toDouble(&ok);
+    if (!ok) {
+        qDebug() << "invalid tns float: " << QByteArray(data, size);
+        return false;
+    }
+
+    quint64 bits;
+    memcpy(&bits, &value, sizeof(bits));
+    out().append(char(0xcb));
+    msgpack_append_be(out(), bits, 8);
+    counted();
+    return true;
+}
+
+
+bool
+MsgPackWriter::string(const char *data, int size)
+{
+    msgpack_append_string(out(), data, size);
+    counted();
+    return true;
+}
+
+
+bool
+MsgPackWriter::beginList()
+{
+    m_payloads.append(QByteArray());
+    m_counts.append(0);
+    m_types.append(']');
+    return true;
+}
+
+
+bool
+MsgPackWriter::beginMap()
+{
+    m_payloads.append(QByteArray());
+    m_counts.append(0);
+    m_types.append('}');
+    return true;
+}
+
+
+bool
+MsgPackWriter::key(const char *data, int size)
+{
+    // keys are not counted, a map header holds the number of pairs
+    msgpack_append_string(out(), data, size);
+    return true;
+}
+
+
+bool
+MsgPackWriter::end(bool is_map)
+{
+    if (m_types.isEmpty() || (m_types.at(m_types.size() - 1) != (is_map ? '}' : ']'))) {
+        qDebug() << "closing a container which is not open";
+        return false;
+    }
+
+    QByteArray payload = m_payloads.takeLast();
+    int count = m_counts.takeLast();
+    m_types.chop(1);
+
+    QByteArray &buffer = out();
+    if (is_map) {
+        msgpack_append_container(buffer, count, 0x80, 0xde);
+    }
+    else {
+        msgpack_append_container(buffer, count, 0x90, 0xdc);
+    }
+    buffer.append(payload);
+    counted();
+    return true;
+}
+
+
+bool
+MsgPackWriter::endList()
+{
+    return end(false);
+}
+
+
+bool
+MsgPackWriter::endMap()
+{
+    return end(true);
+}
+
+
+/**
+ * reads one object after the other and reports it to the handler
+ */
+class MsgPackReader {
+public:
+    MsgPackReader(const QByteArray &msgpack, Handler &handler)
+        : m_pos(reinterpret_cast<const uchar *>(msgpack.constData())),
+          m_end(m_pos + msgpack.size()), m_handler(handler), m_depth(0)
+    {
+    }
+
+    bool document()
+    {
+        if (!object(false)) {
+            return false;
+        }
+        if (m_pos != m_end) {
+            qDebug() << "trailing bytes after msgpack object";
+            return false;
+        }
+        return true;
+    }
+
+private:
+    bool read_be(int bytes, quint64 &value)
+    {
+        if ((m_end - m_pos) < bytes) {
+            qDebug() << "unexpected end of msgpack";
+            return false;
+        }
+        value = 0;
+        for (int i = 0; i < bytes; ++i) {
+            value = (value << 8) | *m_pos++;
+        }
+        return true;
+    }
+
+    bool string(quint64 length, bool is_key)
+    {
+        if (quint64(m_end - m_pos) < length) {
+            qDebug() << "unexpected end of msgpack";
+            return false;
+        }
+        const char *data = reinterpret_cast<const char *>(m_pos);
+        m_pos += length;
+        return is_key ? m_handler.key(data, int(length)) : m_handler.string(data, int(length));
+    }
+
+    bool integer(qint64 value)
+    {
+        QByteArray text = QByteArray::number(value);
+        return m_handler.integer(text.constData(), text.size());
+    }
+
+    bool floating(double value)
+    {
+        QByteArray text = QByteArray::number(value, 'g', 17);
+        return m_handler.floating(text.constData(), text.size());
+    }
+
+    bool enter()
+    {
+        if (m_depth >= MAX_NESTING_DEPTH) {
+            qDebug() << "msgpack is nested too deeply";
+            return false;
+        }
+        ++m_depth;
+        return true;
+    }
+
+    bool list(quint64 count)
+    {
+        if (!enter() || !m_handler.beginList()) {
+            return false;
+        }
+        for (quint64 i = 0; i < count; ++i) {
+            if (!object(false)) {
+                return false;
+            }
+        }
+        --m_depth;
+        return m_handler.endList();
+    }
+
+    bool map(quint64 count)
+    {
+        if (!enter() || !m_handler.beginMap()) {
+            return false;
+        }
+        for (quint64 i = 0; i < count; ++i) {
+            if (!object(true) || !object(false)) {
+                return false;
+            }
+        }
+        --m_depth;
+        return m_handler.endMap();
+    }
+
+    bool object(bool is_key)
+    {
+        if (m_pos >= m_end) {
+            qDebug() << "unexpected end of msgpack";
+            return false;
+        }
+
+        uchar marker = *m_pos++;
+        quint64 value;
+
+        if ((marker >= 0xa0) && (marker <= 0xbf)) {
+            return string(marker & 0x1f, is_key);
+        }
+        if ((marker == 0xd9) || (marker == 0xda) || (marker == 0xdb)
+                    || (marker == 0xc4) || (marker == 0xc5) || (marker == 0xc6)) {
+            int bytes = 1 << ((marker >= 0xd9) ? (marker - 0xd9) : (marker - 0xc4));
+            return read_be(bytes, value) && string(value, is_key);
+        }
+        if (is_key) {
+            qDebug() << "tns map keys are only allowed to be strings";
+            return false;
+        }
+
+        if (marker <= 0x7f) {
+            return integer(marker);
+        }
+        if (marker >= 0xe0) {
+            return integer(qint64(marker) - 256);
+        }
+        if (marker <= 0x8f) {
+            return map(marker & 0x0f);
+        }
+        if (marker <= 0x9f) {
+            return list(marker & 0x0f);
+        }
+
+        switch (marker) {
+            case 0xc0:
+                return m_handler.null();
+            case 0xc2:
+                return m_handler.boolean(false);
+            case 0xc3:
+                return m_handler.boolean(true);
+            case 0xca: {
+                if (!read_be(4, value)) {
+                    return false;
+                }
+                quint32 bits = quint32(value);
+                float value32;
+                memcpy(&value32, &bits, sizeof(value32));
+                return floating(value32);
+            }
+            case 0xcb: {
+                if (!read_be(8, value)) {
+                    return false;
+                }
+                double value64;
+                memcpy(&value64, &value, sizeof(value64));
+                return floating(value64);
+            }
+            case 0xcc:
+            case 0xcd:
+            case 0xce:
+                return read_be(1 << (marker - 0xcc), value) && integer(qint64(value));
+            case 0xcf: {
+                if (!read_be(8, value)) {
+                    return false;
+                }
+                QByteArray text = QByteArray::number(value);
+                return m_handler.integer(text.constData(), text.size());
+            }
+            case 0xd0:
+                return read_be(1, value) && integer(qint8(value));
+            case 0xd1:
+                return read_be(2, value) && integer(qint16(value));
+            case 0xd2:
+                return read_be(4, value) && integer(qint32(value));
+            case 0xd3:
+                return read_be(8, value) && integer(qint64(value));
+            case 0xdc:
+                return read_be(2, value) && list(value);
+            case 0xdd:
+                return read_be(4, value) && list(value);
+            case 0xde:
+                return read_be(2, value) && map(value);
+            case 0xdf:
+                return read_be(4, value) && map(value);
+        }
+
+        qDebug() << "unsupported msgpack type: " << int(marker);
+        return false;
+    }
+
+    const uchar *m_pos;
+    const uchar *m_end;
+    Handler &m_handler;
+    int m_depth;
+};
+
+
+void
+QTNetString::readMsgPack(const QByteArray &msgpack, Handler &handler, bool &ok)
+{
+    MsgPackReader reader(msgpack, handler);
+    ok = reader.document();
+}
+
+
+QByteArray
+QTNetString::toMsgPack(const QByteArray &tnetstring, bool &ok)
+{
+    MsgPackWriter writer;
+    qint64 tns_end_pos;
+
+    walk(tnetstring.constData(), tnetstring.size(), 0, tns_end_pos, writer, ok);
+    if (!ok) {
+        return QByteArray();
+    }
+    return writer.msgpack();
+}
+
+
+QByteArray
+QTNetString::fromMsgPack(const QByteArray &msgpack, bool &ok)
+{
+    Writer writer;
+
+    readMsgPack(msgpack, writer, ok);
+    if (!ok) {
+        return QByteArray();
+    }
+    return writer.tns();
+}
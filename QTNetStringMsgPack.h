@@ -0,0 +1,81 @@
+#ifndef __qtnetstring_msgpack_h__
+#define __qtnetstring_msgpack_h__
+
+
+#include "QByteArray"
+#include "QList"
+
+#include "QTNetStringSax.h"
+
+
+namespace QTNetString {
+
+    /**
+     * Convert a TNetString to MessagePack without building a QVariant
+     * structure in between. TNetString strings and map keys which
+     * are valid UTF-8 become MessagePack str values, all others bin
+     * values, as TNetString strings may hold any bytes.
+     *
+     * sets ok to false and returns an empty QByteArray if the
+     * tnetstring is not valid.
+     */
+    QByteArray toMsgPack(const QByteArray &tnetstring, bool &ok);
+
+    /**
+     * Convert a MessagePack object to a TNetString without building
+     * a QVariant structure in between. str and bin both become
+     * TNetString strings.
+     *
+     * sets ok to false and returns an empty QByteArray if the data is
+     * not valid, nested deeper than MAX_NESTING_DEPTH, contains ext
+     * types or map keys which are not strings.
+     */
+    QByteArray fromMsgPack(const QByteArray &msgpack, bool &ok);
+
+    /**
+     * Report the contents of a MessagePack object to handler in the
+     * same way walk() reports the contents of a TNetString.
+     */
+    void readMsgPack(const QByteArray &msgpack, Handler &handler, bool &ok);
+
+    /**
+     * A handler which encodes the events it receives as MessagePack.
+     *
+     * MessagePack needs the number of elements in front of a list or
+     * map, so the contents of open containers are collected until the
+     * container is closed.
+     */
+    class MsgPackWriter : public Handler {
+    public:
+        MsgPackWriter();
+
+        QByteArray msgpack() const;
+
+        bool null();
+        bool boolean(bool value);
+        bool integer(const char *data, int size);
+        bool floating(const char *data, int size);
+        bool string(const char *data, int size);
+
+        bool beginList();
+        bool endList();
+
+        bool beginMap();
+        bool key(const char *data, int size);
+        bool endMap();
+
+    private:
+        QByteArray &out();
+        void counted();
+        bool end(bool is_map);
+
+        QList<QByteArray> m_payloads;
+        QList<int> m_counts;
+        QByteArray m_types;
+        QByteArray m_msgpack;
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,84 @@
+#include "QTNetStringParseCache.h"
+#include "QTNetString.h"
+
+#include <QMutexLocker>
+
+
+using namespace QTNetString;
+
+
+ParseCache::ParseCache(int max_bytes)
+    : m_cache(max_bytes), m_hits(0), m_misses(0)
+{
+}
+
+
+QVariant
+ParseCache::parse(const QByteArray &tnetstring, bool &ok)
+{
+    quint64 digest = hash(tnetstring.constData(), tnetstring.size());
+
+    {
+        QMutexLocker locker(&m_mutex);
+        Entry *entry = m_cache.object(digest);
+        if (entry && (entry->tnetstring == tnetstring)) {
+            ++m_hits;
+            ok = true;
+            return entry->value;
+        }
+        ++m_misses;
+    }
+
+    // parse without holding the lock, other threads may
+    // hit the cache in the meantime
+    QVariant value = QTNetString::parse(tnetstring, ok);
+    if (ok) {
+        Entry *entry = new Entry;
+        entry->tnetstring = tnetstring;
+        entry->value = value;
+
+        QMutexLocker locker(&m_mutex);
+        m_cache.insert(digest, entry, qMax(1, tnetstring.size()));
+    }
+    return value;
+}
+
+
+int
+ParseCache::maxBytes() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_cache.maxCost();
+}
+
+
+void
+ParseCache::setMaxBytes(int max_bytes)
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.setMaxCost(max_bytes);
+}
+
+
+quint64
+ParseCache::hits() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_hits;
+}
+
+
+quint64
+ParseCache::misses() const
+{
+    QMutexLocker locker(&m_mutex);
+    return m_misses;
+}
+
+
+void
+ParseCache::clear()
+{
+    QMutexLocker locker(&m_mutex);
+    m_cache.clear();
+}
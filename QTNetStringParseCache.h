@@ -0,0 +1,70 @@
+#ifndef __qtnetstring_parsecache_h__
+#define __qtnetstring_parsecache_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QCache"
+#include "QMutex"
+
+
+namespace QTNetString {
+
+    /**
+     * Remembers the values of recently parsed TNetStrings, for
+     * clients which receive the same bytes again and again.
+     *
+     * Entries are found by the hash of the tnetstring and compared
+     * byte by byte before a cached value is returned. The returned
+     * values are implicitly shared with the cache, so a hit does not
+     * copy the parsed structure.
+     *
+     * The size of the cache is limited by the sum of the sizes of the
+     * cached tnetstrings. The least recently used entries are removed
+     * first. All methods are thread-safe.
+     */
+    class ParseCache {
+    public:
+        ParseCache(int max_bytes = 16 * 1024 * 1024);
+
+        /**
+         * the same as QTNetString::parse, but returns the cached value
+         * if the same tnetstring has been parsed before.
+         *
+         * Only values which could be parsed are cached.
+         */
+        QVariant parse(const QByteArray &tnetstring, bool &ok);
+
+        int maxBytes() const;
+        void setMaxBytes(int max_bytes);
+
+        /**
+         * number of tnetstrings answered from the cache
+         */
+        quint64 hits() const;
+
+        /**
+         * number of tnetstrings which had to be parsed
+         */
+        quint64 misses() const;
+
+        void clear();
+
+    private:
+        struct Entry {
+            QByteArray tnetstring;
+            QVariant value;
+        };
+
+        QCache<quint64, Entry> m_cache;
+        quint64 m_hits;
+        quint64 m_misses;
+        mutable QMutex m_mutex;
+
+        Q_DISABLE_COPY(ParseCache)
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,111 @@
+#include "QTNetStringPipeline.h"
+#include "QTNetString.h"
+
+#include <QIODevice>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+
+using namespace QTNetString;
+
+/* number of bytes requested from the device at once */
+static const int PIPELINE_READ_SIZE = 64 * 1024;
+
+
+ParsePipeline::ParsePipeline(QIODevice *device, int max_in_flight)
+    : m_device(device), m_max_in_flight(qMax(1, max_in_flight)),
+      m_device_at_end(false), m_done(false), m_framing_ok(true)
+{
+}
+
+
+ParsePipeline::~ParsePipeline()
+{
+    while (!m_in_flight.isEmpty()) {
+        m_in_flight.dequeue().waitForFinished();
+    }
+}
+
+
+ParsePipeline::Result
+ParsePipeline::parse_record(const QByteArray &record)
+{
+    Result result;
+    result.value = parse(record, result.ok);
+    return result;
+}
+
+
+/**
+ * cut the next record out of the stream. Returns false at the
+ * end of the stream or on errors.
+ */
+bool
+ParsePipeline::read_record(QByteArray &record, bool &ok)
+{
+    ok = true;
+
+    while (true) {
+        if (m_decoder.nextFrame(record, ok)) {
+            return true;
+        }
+        if (!ok) {
+            return false;
+        }
+
+        if (m_device_at_end) {
+            if (m_decoder.bufferedBytes() > 0) {
+                qDebug() << "stream ends with an incomplete tns";
+                ok = false;
+            }
+            return false;
+        }
+
+        QByteArray chunk = m_device->read(PIPELINE_READ_SIZE);
+        if (chunk.isEmpty() && !m_device->waitForReadyRead(-1)) {
+            m_device_at_end = true;
+        }
+        m_decoder.feed(chunk);
+    }
+}
+
+
+/**
+ * start parsing records until max_in_flight records are waiting
+ * to be consumed
+ */
+void
+ParsePipeline::fill()
+{
+    while (!m_done && (m_in_flight.size() < m_max_in_flight)) {
+        QByteArray record;
+        if (!read_record(record, m_framing_ok)) {
+            m_done = true;
+            break;
+        }
+        m_in_flight.enqueue(QtConcurrent::run(&ParsePipeline::parse_record, record));
+    }
+}
+
+
+bool
+ParsePipeline::next(QVariant &value, bool &ok)
+{
+    fill();
+
+    // a framing error is reported after all records before
+    // it have been delivered
+    if (m_in_flight.isEmpty()) {
+        ok = m_framing_ok;
+        return false;
+    }
+
+    Result result = m_in_flight.dequeue().result();
+    ok = result.ok;
+    if (!ok) {
+        return false;
+    }
+
+    value = result.value;
+    return true;
+}
@@ -0,0 +1,70 @@
+#ifndef __qtnetstring_pipeline_h__
+#define __qtnetstring_pipeline_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QQueue"
+#include "QFuture"
+
+#include "QTNetStringDecoder.h"
+
+
+class QIODevice;
+
+
+namespace QTNetString {
+
+    /**
+     * Parse a stream of concatenated TNetStrings using all cores.
+     *
+     * The records are cut out of the stream by looking at their
+     * size prefixes only, the actual parsing happens in the global
+     * QThreadPool. Parsed values are returned in the order of the
+     * stream.
+     *
+     * At most max_in_flight records are read ahead of the value
+     * returned by next(), which bounds the memory used by the
+     * pipeline.
+     */
+    class ParsePipeline {
+    public:
+        ParsePipeline(QIODevice *device, int max_in_flight = 256);
+        ~ParsePipeline();
+
+        /**
+         * wait for the next record of the stream and write its
+         * value to value.
+         *
+         * returns false when the end of the stream is reached or
+         * an error occured. ok is set to false if the stream or one
+         * of its records is not a valid tns.
+         */
+        bool next(QVariant &value, bool &ok);
+
+    private:
+        struct Result {
+            QVariant value;
+            bool ok;
+        };
+
+        static Result parse_record(const QByteArray &record);
+
+        bool read_record(QByteArray &record, bool &ok);
+        void fill();
+
+        QIODevice *m_device;
+        int m_max_in_flight;
+        Decoder m_decoder;
+        bool m_device_at_end;
+        bool m_done;
+        bool m_framing_ok;
+        QQueue<QFuture<Result> > m_in_flight;
+
+        Q_DISABLE_COPY(ParsePipeline)
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,300 @@
+#include "QTNetStringSax.h"
+#include "QTNetString.h"
+
+#include <QDebug>
+
+#include <string.h>
+
+
+using namespace QTNetString;
+
+
+/**
+ * walk the tns at pos which has to end before limit. Map keys are
+ * reported with is_key set, depth is the number of containers
+ * around the tns.
+ */
+static void
+walk_element(const char *data, qint64 limit, qint64 pos, qint64 &tns_end_pos,
+            Handler &handler, bool is_key, int depth, bool &ok)
+{
+    if (!frame(data, limit, pos, tns_end_pos, ok)) {
+        if (ok) {
+            qDebug() << "tns exceeds its container";
+            ok = false;
+        }
+        return;
+    }
+
+    const char *colon = static_cast<const char *>(memchr(data + pos, ':', tns_end_pos - pos));
+    const char *pl_data = colon + 1;
+    int pl_size = int((data + tns_end_pos - 1) - pl_data);
+    char type = data[tns_end_pos - 1];
+
+    if (is_key) {
+        if (type != ',') {
+            qDebug() << "tns map keys are only allowed to be strings";
+            ok = false;
+            return;
+        }
+        ok = handler.key(pl_data, pl_size);
+        return;
+    }
+
+    if (((type == ']') || (type == '}')) && (depth >= MAX_NESTING_DEPTH)) {
+        qDebug() << "tns is nested too deeply";
+        ok = false;
+        return;
+    }
+
+    switch (type) {
+        case '~':
+            ok = handler.null();
+            break;
+        case ',':
+            ok = handler.string(pl_data, pl_size);
+            break;
+        case '!':
+            ok = handler.boolean((pl_size == 4) && (memcmp(pl_data, "true", 4) == 0));
+            break;
+        case '#':
+            ok = handler.integer(pl_data, pl_size);
+            break;
+        case '^':
+            ok = handler.floating(pl_data, pl_size);
+            break;
+        case ']': {
+            ok = handler.beginList();
+            qint64 element_pos = pl_data - data;
+            qint64 pl_end = tns_end_pos - 1;
+            while (ok && (element_pos < pl_end)) {
+                walk_element(data, pl_end, element_pos, element_pos, handler, false,
+                            depth + 1, ok);
+            }
+            if (ok) {
+                ok = handler.endList();
+            }
+            break;
+        }
+        case '}': {
+            ok = handler.beginMap();
+            qint64 element_pos = pl_data - data;
+            qint64 pl_end = tns_end_pos - 1;
+            while (ok && (element_pos < pl_end)) {
+                walk_element(data, pl_end, element_pos, element_pos, handler, true,
+                            depth + 1, ok);
+                if (ok && (element_pos >= pl_end)) {
+                    qDebug() << "tns map key without value";
+                    ok = false;
+                }
+                if (ok) {
+                    walk_element(data, pl_end, element_pos, element_pos, handler, false,
+                                depth + 1, ok);
+                }
+            }
+            if (ok) {
+                ok = handler.endMap();
+            }
+            break;
+        }
+    }
+}
+
+
+void
+QTNetString::walk(const char *data, qint64 data_size, qint64 tns_start_pos,
+            qint64 &tns_end_pos, Handler &handler, bool &ok)
+{
+    ok = true;
+    walk_element(data, data_size, tns_start_pos, tns_end_pos, handler, false, 0, ok);
+}
+
+
+bool
+QTNetString::isUtf8(const char *data, int size)
+{
+    const uchar *pos = reinterpret_cast<const uchar *>(data);
+    const uchar *end = pos + size;
+
+    while (pos < end) {
+        uchar lead = *pos++;
+        if (lead < 0x80) {
+            continue;
+        }
+
+        int continuations;
+        uint code;
+        uint min_code;
+        if ((lead & 0xe0) == 0xc0) {
+            continuations = 1;
+            code = lead & 0x1f;
+            min_code = 0x80;
+        }
+        else if ((lead & 0xf0) == 0xe0) {
+            continuations = 2;
+            code = lead & 0x0f;
+            min_code = 0x800;
+        }
+        else if ((lead & 0xf8) == 0xf0) {
+            continuations = 3;
+            code = lead & 0x07;
+            min_code = 0x10000;
+        }
+        else {
+            return false;
+        }
+
+        if ((end - pos) < continuations) {
+            return false;
+        }
+        for (int i = 0; i < continuations; ++i, ++pos) {
+            if ((*pos & 0xc0) != 0x80) {
+                return false;
+            }
+            code = (code << 6) | (*pos & 0x3f);
+        }
+
+        // overlong forms, surrogates and code points beyond unicode
+        if ((code < min_code) || ((code >= 0xd800) && (code <= 0xdfff)) || (code > 0x10ffff)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+
+Writer::Writer()
+{
+}
+
+
+QByteArray
+Writer::tns() const
+{
+    return m_tns;
+}
+
+
+bool
+Writer::isComplete() const
+{
+    return m_types.isEmpty() && !m_tns.isEmpty();
+}
+
+
+void
+Writer::clear()
+{
+    m_payloads.clear();
+    m_types.clear();
+    m_tns.clear();
+}
+
+
+/**
+ * append a tns to the innermost open container, or to the
+ * result if there is none
+ */
+bool
+Writer::append(const char *data, int size, char type)
+{
+    QByteArray &out = m_payloads.isEmpty() ? m_tns : m_payloads.last();
+    out.append(QByteArray::number(size));
+    out.append(':');
+    out.append(data, size);
+    out.append(type);
+    return true;
+}
+
+
+bool
+Writer::begin(char type)
+{
+    m_payloads.append(QByteArray());
+    m_types.append(type);
+    return true;
+}
+
+
+bool
+Writer::end(char type)
+{
+    if (m_types.isEmpty() || (m_types.at(m_types.size() - 1) != type)) {
+        qDebug() << "closing a container which is not open";
+        return false;
+    }
+
+    QByteArray payload = m_payloads.takeLast();
+    m_types.chop(1);
+    return append(payload.constData(), payload.size(), type);
+}
+
+
+bool
+Writer::null()
+{
+    return append("", 0, '~');
+}
+
+
+bool
+Writer::boolean(bool value)
+{
+    return value ? append("true", 4, '!') : append("false", 5, '!');
+}
+
+
+bool
+Writer::integer(const char *data, int size)
+{
+    return append(data, size, '#');
+}
+
+
+bool
+Writer::floating(const char *data, int size)
+{
+    return append(data, size, '^');
+}
+
+
+bool
+Writer::string(const char *data, int size)
+{
+    return append(data, size, ',');
+}
+
+
+bool
+Writer::beginList()
+{
+    return begin(']');
+}
+
+
+bool
+Writer::endList()
+{
+    return end(']');
+}
+
+
+bool
+Writer::beginMap()
+{
+    return begin('}');
+}
+
+
+bool
+Writer::key(const char *data, int size)
+{
+    return append(data, size, ',');
+}
+
+
+bool
+Writer::endMap()
+{
+    return end('}');
+}
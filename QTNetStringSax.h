@@ -0,0 +1,115 @@
+#ifndef __qtnetstring_sax_h__
+#define __qtnetstring_sax_h__
+
+
+#include "QByteArray"
+#include "QList"
+
+
+namespace QTNetString {
+
+    /**
+     * Receives the contents of a TNetString as a sequence of events,
+     * without building a QVariant structure.
+     *
+     * All data pointers point into the walked buffer and are only
+     * valid during the call. Integers and floats are passed in their
+     * text form, the handler decides if and how to convert them.
+     *
+     * Every method returns false to abort the walk.
+     */
+    class Handler {
+    public:
+        virtual ~Handler() {}
+
+        virtual bool null() = 0;
+        virtual bool boolean(bool value) = 0;
+        virtual bool integer(const char *data, int size) = 0;
+        virtual bool floating(const char *data, int size) = 0;
+        virtual bool string(const char *data, int size) = 0;
+
+        virtual bool beginList() = 0;
+        virtual bool endList() = 0;
+
+        /**
+         * a map is reported as beginMap(), then key() followed by
+         * the events of the value for every entry, and endMap()
+         */
+        virtual bool beginMap() = 0;
+        virtual bool key(const char *data, int size) = 0;
+        virtual bool endMap() = 0;
+    };
+
+    /**
+     * the deepest nesting of lists and maps walk() and the readers of
+     * other formats accept. Deeper input is rejected instead of
+     * running out of stack.
+     */
+    const int MAX_NESTING_DEPTH = 512;
+
+    /**
+     * Report the contents of the tns at tns_start_pos to handler.
+     *
+     * the position right after the tns will be written to the
+     * tns_end_pos parameter. ok is set to false if the tns is not
+     * valid, is nested deeper than MAX_NESTING_DEPTH or the handler
+     * aborted the walk.
+     */
+    void walk(const char *data, qint64 data_size, qint64 tns_start_pos,
+                qint64 &tns_end_pos, Handler &handler, bool &ok);
+
+    /**
+     * true if data is valid UTF-8 text. TNetString strings are
+     * arbitrary bytes, handlers writing formats which distinguish
+     * text from binary strings use this to choose between them.
+     */
+    bool isUtf8(const char *data, int size);
+
+    /**
+     * A handler which encodes the events it receives into a
+     * TNetString. Used to produce TNetStrings from other formats.
+     */
+    class Writer : public Handler {
+    public:
+        Writer();
+
+        /**
+         * the encoded TNetString. Only complete once every
+         * container has been closed.
+         */
+        QByteArray tns() const;
+
+        /**
+         * true if all containers are closed again
+         */
+        bool isComplete() const;
+
+        void clear();
+
+        bool null();
+        bool boolean(bool value);
+        bool integer(const char *data, int size);
+        bool floating(const char *data, int size);
+        bool string(const char *data, int size);
+
+        bool beginList();
+        bool endList();
+
+        bool beginMap();
+        bool key(const char *data, int size);
+        bool endMap();
+
+    private:
+        bool append(const char *data, int size, char type);
+        bool begin(char type);
+        bool end(char type);
+
+        QList<QByteArray> m_payloads;
+        QByteArray m_types;
+        QByteArray m_tns;
+    };
+
+}
+
+
+#endif
@@ -0,0 +1,392 @@
+#include "QTNetStringSchema.h"
+#include "QTNetString.h"
+#include "QTNetStringSax.h"
+
+#include <QFuture>
+#include <QThread>
+#include <QtConcurrentRun>
+#include <QDebug>
+
+#include <math.h>
+
+
+using namespace QTNetString;
+
+
+/* sizes below are counted exactly, above in 16 buckets per power of two */
+static const int EXACT_SIZES = 16;
+static const int SIZE_BUCKETS = EXACT_SIZES + (64 * 16);
+
+
+namespace QTNetString {
+
+    /**
+     * counts the values of one record. The path of the current value
+     * is kept in a single QByteArray which is cut back to the path of
+     * the container when leaving it, so only new paths allocate.
+     *
+     * The counts go to a scratch Statistics first and are only added
+     * to the target by commit(), so an invalid record adds nothing.
+     * The scratch keeps its paths between records, only the paths
+     * touched by a record are merged and reset.
+     */
+    class StatisticsHandler : public Handler {
+    public:
+        StatisticsHandler(int max_paths)
+            : m_statistics(max_paths)
+        {
+        }
+
+        /**
+         * add the counts of the record walked last to target
+         */
+        void commit(Statistics &target)
+        {
+            for (int i = 0; i < m_touched.size(); ++i) {
+                target.merge_path(m_touched.at(i), m_statistics.m_paths.value(m_touched.at(i)));
+            }
+            target.m_max_depth = qMax(target.m_max_depth, m_statistics.m_max_depth);
+            target.m_dropped_values += m_statistics.m_dropped_values;
+            reset();
+        }
+
+        /**
+         * forget the counts of the record walked last
+         */
+        void reset()
+        {
+            for (int i = 0; i < m_touched.size(); ++i) {
+                m_statistics.m_paths[m_touched.at(i)] = Statistics::PathStatistics();
+            }
+            m_touched.clear();
+            m_statistics.m_max_depth = 0;
+            m_statistics.m_dropped_values = 0;
+            m_path.clear();
+            m_parents.clear();
+            m_list.clear();
+        }
+
+        bool null()
+        {
+            return value(Statistics::Null, 0);
+        }
+
+        bool boolean(bool)
+        {
+            return value(Statistics::Boolean, 0);
+        }
+
+        bool integer(const char *, int size)
+        {
+            return value(Statistics::Integer, size);
+        }
+
+        bool floating(const char *, int size)
+        {
+            return value(Statistics::Float, size);
+        }
+
+        bool string(const char *, int size)
+        {
+            return value(Statistics::String, size);
+        }
+
+        bool beginList()
+        {
+            return begin(Statistics::List);
+        }
+
+        bool endList()
+        {
+            return end();
+        }
+
+        bool beginMap()
+        {
+            return begin(Statistics::Map);
+        }
+
+        bool key(const char *data, int size)
+        {
+            m_path.resize(m_parents.last());
+            if (!m_path.isEmpty()) {
+                m_path.append('.');
+            }
+            m_path.append(data, size);
+            return true;
+        }
+
+        bool endMap()
+        {
+            return end();
+        }
+
+    private:
+        bool value(Statistics::ValueType type, int size)
+        {
+            // map values get their path from key()
+            if (!m_list.isEmpty() && m_list.last()) {
+                m_path.resize(m_parents.last());
+                m_path.append("[]");
+            }
+
+            QHash<QByteArray, Statistics::PathStatistics>::iterator iter
+                        = m_statistics.m_paths.find(m_path);
+            if (iter == m_statistics.m_paths.end()) {
+                if (m_statistics.m_paths.size() >= m_statistics.m_max_paths) {
+                    ++m_statistics.m_dropped_values;
+                    return true;
+                }
+                iter = m_statistics.m_paths.insert(m_path, Statistics::PathStatistics());
+            }
+
+            Statistics::PathStatistics &path = iter.value();
+            if (path.count == 0) {
+                m_touched.append(iter.key());
+            }
+            ++path.count;
+            ++path.types[type];
+            path.max_size = qMax(path.max_size, size);
+            return true;
+        }
+
+        bool begin(Statistics::ValueType type)
+        {
+            value(type, 0);
+            m_parents.append(m_path.size());
+            m_list.append(type == Statistics::List);
+            m_statistics.m_max_depth = qMax(m_statistics.m_max_depth, m_parents.size());
+            return true;
+        }
+
+        bool end()
+        {
+            m_path.resize(m_parents.last());
+            m_parents.removeLast();
+            m_list.removeLast();
+            return true;
+        }
+
+        Statistics m_statistics;
+        QVector<QByteArray> m_touched;
+        QByteArray m_path;
+        QVector<int> m_parents;
+        QVector<bool> m_list;
+    };
+
+}
+
+
+Statistics::PathStatistics::PathStatistics()
+    : count(0), max_size(0)
+{
+    for (int i = 0; i < ValueTypeCount; ++i) {
+        types[i] = 0;
+    }
+}
+
+
+Statistics::Statistics(int max_paths)
+    : m_max_paths(max_paths), m_records(0), m_bytes(0), m_max_record_size(0),
+      m_max_depth(0), m_dropped_values(0), m_size_histogram(SIZE_BUCKETS, 0)
+{
+}
+
+
+int
+Statistics::size_bucket(qint64 size)
+{
+    if (size < EXACT_SIZES) {
+        return int(size);
+    }
+
+    int exponent = 4;
+    while ((size >> (exponent + 1)) != 0) {
+        ++exponent;
+    }
+    int sub_bucket = int(size >> (exponent - 4)) & 15;
+    return EXACT_SIZES + ((exponent - 4) * 16) + sub_bucket;
+}
+
+
+qint64
+Statistics::bucket_limit(int bucket)
+{
+    if (bucket < EXACT_SIZES) {
+        return bucket;
+    }
+
+    int exponent = ((bucket - EXACT_SIZES) / 16) + 4;
+    qint64 sub_bucket = (bucket - EXACT_SIZES) % 16;
+    return ((16 + sub_bucket + 1) << (exponent - 4)) - 1;
+}
+
+
+void
+Statistics::add(const char *data, qint64 data_size, bool &ok)
+{
+    StatisticsHandler handler(m_max_paths);
+    qint64 pos = 0;
+
+    ok = true;
+    while (ok && (pos < data_size)) {
+        qint64 tns_end_pos;
+        walk(data, data_size, pos, tns_end_pos, handler, ok);
+        if (!ok) {
+            qDebug() << "invalid record at offset " << pos;
+            break;
+        }
+        handler.commit(*this);
+
+        qint64 size = tns_end_pos - pos;
+        ++m_records;
+        m_bytes += size;
+        m_max_record_size = qMax(m_max_record_size, size);
+        ++m_size_histogram[size_bucket(size)];
+        pos = tns_end_pos;
+    }
+}
+
+
+void
+Statistics::merge(const Statistics &other)
+{
+    m_records += other.m_records;
+    m_bytes += other.m_bytes;
+    m_max_record_size = qMax(m_max_record_size, other.m_max_record_size);
+    m_max_depth = qMax(m_max_depth, other.m_max_depth);
+    m_dropped_values += other.m_dropped_values;
+
+    for (int i = 0; i < SIZE_BUCKETS; ++i) {
+        m_size_histogram[i] += other.m_size_histogram.at(i);
+    }
+
+    QHash<QByteArray, PathStatistics>::const_iterator iter;
+    for (iter = other.m_paths.constBegin(); iter != other.m_paths.constEnd(); ++iter) {
+        merge_path(iter.key(), iter.value());
+    }
+}
+
+
+void
+Statistics::merge_path(const QByteArray &path, const PathStatistics &other)
+{
+    QHash<QByteArray, PathStatistics>::iterator own = m_paths.find(path);
+    if (own == m_paths.end()) {
+        if (m_paths.size() >= m_max_paths) {
+            m_dropped_values += other.count;
+            return;
+        }
+        own = m_paths.insert(path, PathStatistics());
+    }
+
+    own.value().count += other.count;
+    for (int i = 0; i < ValueTypeCount; ++i) {
+        own.value().types[i] += other.types[i];
+    }
+    own.value().max_size = qMax(own.value().max_size, other.max_size);
+}
+
+
+qint64
+Statistics::records() const
+{
+    return m_records;
+}
+
+
+qint64
+Statistics::bytes() const
+{
+    return m_bytes;
+}
+
+
+int
+Statistics::maxDepth() const
+{
+    return m_max_depth;
+}
+
+
+qint64
+Statistics::recordSize(double percentile) const
+{
+    if ((m_records == 0) || (percentile >= 100.0)) {
+        return m_max_record_size;
+    }
+
+    qint64 rank = qint64(ceil((percentile / 100.0) * m_records));
+    qint64 seen = 0;
+    for (int i = 0; i < SIZE_BUCKETS; ++i) {
+        seen += m_size_histogram.at(i);
+        if ((seen >= rank) && (seen > 0)) {
+            return qMin(bucket_limit(i), m_max_record_size);
+        }
+    }
+    return m_max_record_size;
+}
+
+
+QMap<QByteArray, Statistics::PathStatistics>
+Statistics::paths() const
+{
+    QMap<QByteArray, PathStatistics> sorted;
+    QHash<QByteArray, PathStatistics>::const_iterator iter;
+    for (iter = m_paths.constBegin(); iter != m_paths.constEnd(); ++iter) {
+        sorted.insert(iter.key(), iter.value());
+    }
+    return sorted;
+}
+
+
+qint64
+Statistics::droppedValues() const
+{
+    return m_dropped_values;
+}
+
+
+struct ChunkStatistics {
+    Statistics statistics;
+    bool ok;
+};
+
+
+static ChunkStatistics
+chunk_statistics(const char *data, qint64 data_size, int max_paths)
+{
+    ChunkStatistics chunk;
+    chunk.statistics = Statistics(max_paths);
+    chunk.statistics.add(data, data_size, chunk.ok);
+    return chunk;
+}
+
+
+Statistics
+QTNetString::inferStatistics(const char *data, qint64 data_size, bool &ok, int thread_count,
+            int max_paths)
+{
+    if (thread_count <= 0) {
+        thread_count = QThread::idealThreadCount();
+    }
+
+    QList<qint64> cuts = splitRecords(data, data_size, thread_count);
+
+    QList<QFuture<ChunkStatistics> > chunks;
+    for (int i = 1; i < cuts.size(); ++i) {
+        chunks.append(QtConcurrent::run(chunk_statistics, data + cuts.at(i - 1),
+                    cuts.at(i) - cuts.at(i - 1), max_paths));
+    }
+
+    Statistics statistics(max_paths);
+    ok = true;
+    for (int i = 0; i < chunks.size(); ++i) {
+        ChunkStatistics chunk = chunks.at(i).result();
+        if (ok) {
+            statistics.merge(chunk.statistics);
+            ok = chunk.ok;
+        }
+    }
+    return statistics;
+}
@@ -0,0 +1,125 @@
+#ifndef __qtnetstring_schema_h__
+#define __qtnetstring_schema_h__
+
+
+#include "QByteArray"
+#include "QHash"
+#include "QMap"
+#include "QVector"
+
+
+namespace QTNetString {
+
+    /**
+     * Shape and size statistics of a stream of concatenated
+     * TNetString records, to find out which keys and types the records
+     * contain and which limits they need.
+     *
+     * Values are counted per path. A path is the keys leading to the
+     * value separated by '.', list elements are written as "[]", so
+     * all elements of a list share one path, e.g. "items[].id". The
+     * root value has the empty path.
+     *
+     * Statistics of separate parts of a stream can be merged, which is
+     * what inferStatistics uses to scan on several threads.
+     */
+    class Statistics {
+    public:
+        enum ValueType {
+            Null,
+            Boolean,
+            Integer,
+            Float,
+            String,
+            List,
+            Map,
+            ValueTypeCount
+        };
+
+        struct PathStatistics {
+            PathStatistics();
+
+            /* number of values at the path */
+            qint64 count;
+            qint64 types[ValueTypeCount];
+            /* the largest string, integer or float payload */
+            int max_size;
+        };
+
+        /**
+         * at most max_paths different paths are counted, values at
+         * further paths are only counted by droppedValues(). This
+         * limits the memory used by records with arbitrary keys.
+         */
+        explicit Statistics(int max_paths = 10000);
+
+        /**
+         * add the records in data.
+         *
+         * sets ok to false if data contains something which is not
+         * a tns. The records before it are counted, nothing of the
+         * invalid record is.
+         */
+        void add(const char *data, qint64 data_size, bool &ok);
+
+        /**
+         * add the counts of other
+         */
+        void merge(const Statistics &other);
+
+        qint64 records() const;
+        qint64 bytes() const;
+
+        /**
+         * the deepest nesting of containers, 0 if the records only
+         * contain scalars.
+         */
+        int maxDepth() const;
+
+        /**
+         * the size of a record which is larger than percentile
+         * percent of all records, e.g. 50 for the median.
+         *
+         * sizes are counted in buckets of 1/16 of a power of two, so
+         * this is the upper end of the bucket, less than 7% above
+         * the exact value. 100 returns the exact maximum.
+         */
+        qint64 recordSize(double percentile) const;
+
+        /**
+         * statistics of all paths, sorted by path
+         */
+        QMap<QByteArray, PathStatistics> paths() const;
+
+        qint64 droppedValues() const;
+
+    private:
+        friend class StatisticsHandler;
+
+        static int size_bucket(qint64 size);
+        static qint64 bucket_limit(int bucket);
+        void merge_path(const QByteArray &path, const PathStatistics &other);
+
+        int m_max_paths;
+        qint64 m_records;
+        qint64 m_bytes;
+        qint64 m_max_record_size;
+        int m_max_depth;
+        qint64 m_dropped_values;
+        QVector<qint64> m_size_histogram;
+        QHash<QByteArray, PathStatistics> m_paths;
+    };
+
+    /**
+     * collect the Statistics of the records in data on thread_count
+     * threads, 0 uses QThread::idealThreadCount().
+     *
+     * sets ok to false if data contains something which is not a tns.
+     */
+    Statistics inferStatistics(const char *data, qint64 data_size, bool &ok,
+                int thread_count = 0, int max_paths = 10000);
+
+}
+
+
+#endif
@@ -0,0 +1,285 @@
+#include "QTNetStringSharedRing.h"
+#include "QTNetString.h"
+
+#include <QAtomicInt>
+#include <QDebug>
+
+#include <new>
+#include <string.h>
+
+
+using namespace QTNetString;
+
+
+/**
+ * Layout of the shared memory segment:
+ *
+ *      Header | frames ...
+ *
+ * head and tail are free running byte counters which are only
+ * reduced to a position inside of the frame area when accessing it.
+ * head is only written by the producer, tail only by the consumer.
+ *
+ * Every frame is a quint32 length followed by the TNetString and is
+ * padded to a multiple of 4 bytes. When a frame does not fit into
+ * the space left before the end of the area, a RING_WRAP marker is
+ * written instead and the frame starts again at the beginning.
+ */
+struct SharedRing::Header {
+    QAtomicInt head;
+    QAtomicInt tail;
+    int capacity;
+    int magic;
+};
+
+static const int RING_MAGIC = 0x544e5352;
+static const quint32 RING_WRAP = 0xffffffff;
+
+
+inline quint32
+ring_align(quint32 size)
+{
+    return (size + 3) & ~quint32(3);
+}
+
+
+inline quint32
+ring_load(QAtomicInt &counter)
+{
+    return quint32(counter.fetchAndAddOrdered(0));
+}
+
+
+inline void
+ring_store(QAtomicInt &counter, quint32 value)
+{
+    counter.fetchAndStoreOrdered(int(value));
+}
+
+
+/**
+ * position of the frame tail points to. Skips a RING_WRAP
+ * marker and adjusts tail accordingly.
+ */
+inline quint32
+ring_frame_pos(const char *frames, quint32 capacity, quint32 &tail)
+{
+    quint32 pos = tail & (capacity - 1);
+    quint32 length;
+    memcpy(&length, frames + pos, sizeof(length));
+    if (length == RING_WRAP) {
+        tail += capacity - pos;
+        pos = 0;
+    }
+    return pos;
+}
+
+
+SharedRing::SharedRing(const QString &key, int capacity, Mode mode)
+    : m_memory(key), m_capacity(capacity), m_mode(mode)
+{
+}
+
+
+SharedRing::~SharedRing()
+{
+    detach();
+}
+
+
+SharedRing::Header *
+SharedRing::header() const
+{
+    return reinterpret_cast<Header *>(const_cast<void *>(m_memory.constData()));
+}
+
+
+char *
+SharedRing::frames() const
+{
+    return reinterpret_cast<char *>(header()) + sizeof(Header);
+}
+
+
+bool
+SharedRing::create()
+{
+    if ((m_capacity < 16) || (m_capacity & (m_capacity - 1))) {
+        qDebug() << "ring capacity must be a power of two";
+        return false;
+    }
+
+    if (!m_memory.create(sizeof(Header) + m_capacity)) {
+        qDebug() << "could not create shared memory: " << m_memory.errorString();
+        return false;
+    }
+
+    Header *h = new (m_memory.data()) Header;
+    ring_store(h->head, 0);
+    ring_store(h->tail, 0);
+    h->capacity = m_capacity;
+    h->magic = RING_MAGIC;
+    return true;
+}
+
+
+bool
+SharedRing::attach()
+{
+    if (!m_memory.attach()) {
+        qDebug() << "could not attach to shared memory: " << m_memory.errorString();
+        return false;
+    }
+
+    if ((m_memory.size() < int(sizeof(Header))) || (header()->magic != RING_MAGIC)) {
+        qDebug() << "shared memory segment is not a tns ring";
+        m_memory.detach();
+        return false;
+    }
+
+    m_capacity = header()->capacity;
+    return true;
+}
+
+
+void
+SharedRing::detach()
+{
+    if (m_memory.isAttached()) {
+        m_memory.detach();
+    }
+}
+
+
+bool
+SharedRing::isAttached() const
+{
+    return m_memory.isAttached();
+}
+
+
+int
+SharedRing::capacity() const
+{
+    return m_capacity;
+}
+
+
+bool
+SharedRing::push(const QByteArray &tns)
+{
+    if (!isAttached()) {
+        return false;
+    }
+
+    quint32 capacity = m_capacity;
+    quint32 need = ring_align(sizeof(quint32) + tns.size());
+    if (need > capacity) {
+        qDebug() << "tns frame is larger than the ring";
+        return false;
+    }
+
+    if ((m_mode == MultiProducer) && !m_memory.lock()) {
+        qDebug() << "could not lock shared memory: " << m_memory.errorString();
+        return false;
+    }
+
+    Header *h = header();
+    char *area = frames();
+    quint32 head = ring_load(h->head);
+    quint32 tail = ring_load(h->tail);
+    quint32 pos = head & (capacity - 1);
+    quint32 skip = ((capacity - pos) < need) ? (capacity - pos) : 0;
+
+    bool pushed = (capacity - (head - tail)) >= (skip + need);
+    if (pushed) {
+        if (skip) {
+            memcpy(area + pos, &RING_WRAP, sizeof(RING_WRAP));
+            head += skip;
+            pos = 0;
+        }
+
+        quint32 length = tns.size();
+        memcpy(area + pos, &length, sizeof(length));
+        memcpy(area + pos + sizeof(length), tns.constData(), length);
+        ring_store(h->head, head + need);
+    }
+
+    if (m_mode == MultiProducer) {
+        m_memory.unlock();
+    }
+    return pushed;
+}
+
+
+bool
+SharedRing::push(const QVariant &value, bool &ok)
+{
+    QByteArray tns = dump(value, ok);
+    if (!ok) {
+        return false;
+    }
+    return push(tns);
+}
+
+
+bool
+SharedRing::peek(QByteArray &tns) const
+{
+    if (!isAttached()) {
+        return false;
+    }
+
+    Header *h = header();
+    quint32 head = ring_load(h->head);
+    quint32 tail = ring_load(h->tail);
+    if (head == tail) {
+        return false;
+    }
+
+    const char *area = frames();
+    quint32 pos = ring_frame_pos(area, m_capacity, tail);
+    quint32 length;
+    memcpy(&length, area + pos, sizeof(length));
+    tns = QByteArray::fromRawData(area + pos + sizeof(length), length);
+    return true;
+}
+
+
+void
+SharedRing::pop()
+{
+    if (!isAttached()) {
+        return;
+    }
+
+    Header *h = header();
+    quint32 head = ring_load(h->head);
+    quint32 tail = ring_load(h->tail);
+    if (head == tail) {
+        return;
+    }
+
+    const char *area = frames();
+    quint32 pos = ring_frame_pos(area, m_capacity, tail);
+    quint32 length;
+    memcpy(&length, area + pos, sizeof(length));
+    ring_store(h->tail, tail + ring_align(sizeof(length) + length));
+}
+
+
+QVariant
+SharedRing::take(bool &ok)
+{
+    QVariant value;
+    QByteArray tns;
+
+    if (!peek(tns)) {
+        ok = false;
+        return value;
+    }
+
+    value = parse(tns, ok);
+    pop();
+    return value;
+}
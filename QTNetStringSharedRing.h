@@ -0,0 +1,110 @@
+#ifndef __qtnetstring_sharedring_h__
+#define __qtnetstring_sharedring_h__
+
+
+#include "QByteArray"
+#include "QVariant"
+#include "QSharedMemory"
+
+
+namespace QTNetString {
+
+    /**
+     * A ring buffer of TNetString frames in shared memory to pass
+     * messages between processes on the same host.
+     *
+     * One process creates the ring, the others attach to it using
+     * the same key. The ring is lock-free for a single producer and a
+     * single consumer. When more than one process pushes into the ring
+     * it has to be opened as MultiProducer, producers then serialize
+     * on the lock of the shared memory segment. Consumers are always
+     * expected to be a single process.
+     *
+     * Frames are stored contiguously, so the consumer can look at
+     * a frame in place without copying it out of the segment.
+     */
+    class SharedRing {
+    public:
+        enum Mode {
+            SingleProducer,
+            MultiProducer
+        };
+
+        /**
+         * capacity is the number of bytes available for frames and
+         * has to be a power of two.
+         */
+        SharedRing(const QString &key, int capacity = 1 << 20,
+                    Mode mode = SingleProducer);
+        ~SharedRing();
+
+        /**
+         * create the shared memory segment. Returns false if the
+         * segment exists already or could not be created.
+         */
+        bool create();
+
+        /**
+         * attach to a segment created by another process.
+         */
+        bool attach();
+
+        void detach();
+        bool isAttached() const;
+
+        /**
+         * copy an already encoded TNetString into the ring.
+         *
+         * returns false if the ring has not enough free space left.
+         */
+        bool push(const QByteArray &tns);
+
+        /**
+         * dump value and push it into the ring.
+         *
+         * sets ok to false if the value could not be dumped. Returns
+         * false if the value could not be dumped or the ring is full.
+         */
+        bool push(const QVariant &value, bool &ok);
+
+        /**
+         * return the oldest frame in the ring without removing it.
+         *
+         * The returned QByteArray does not own its data, it points
+         * directly into the shared memory segment and stays valid
+         * until pop() is called. Returns false if the ring is empty.
+         */
+        bool peek(QByteArray &tns) const;
+
+        /**
+         * release the frame returned by peek()
+         */
+        void pop();
+
+        /**
+         * parse and remove the oldest frame of the ring.
+         *
+         * returns QVariant::Invalid and sets ok to false if the ring
+         * is empty or the frame could not be parsed.
+         */
+        QVariant take(bool &ok);
+
+        int capacity() const;
+
+    private:
+        struct Header;
+
+        Header *header() const;
+        char *frames() const;
+
+        QSharedMemory m_memory;
+        int m_capacity;
+        Mode m_mode;
+
+        Q_DISABLE_COPY(SharedRing)
+    };
+
+}
+
+
+#endif
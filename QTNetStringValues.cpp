@@ -0,0 +1,441 @@
+#include "QTNetStringValues.h"
+#include "QTNetStringSax.h"
+
+#include <QList>
+#include <QDebug>
+
+#if QT_VERSION >= 0x050000
+#include <QJsonArray>
+#include <QJsonObject>
+#endif
+
+#if QT_VERSION >= 0x050C00
+#include <QCborArray>
+#include <QCborMap>
+#endif
+
+
+using namespace QTNetString;
+
+
+/**
+ * wrap payload into a tns of the given type and append it to tns
+ */
+inline void
+append_tns(QByteArray &tns, const QByteArray &payload, char type)
+{
+    tns.append(QByteArray::number(payload.size()));
+    tns.append(':');
+    tns.append(payload);
+    tns.append(type);
+}
+
+
+/**
+ * text of a double for a tns. Integral doubles which can be
+ * represented exactly are written as integers.
+ */
+inline void
+append_number(QByteArray &tns, double value)
+{
+    // the range is checked first, converting NaN, infinity or values
+    // beyond 64 bit to qint64 is undefined
+    if ((qAbs(value) <= 9007199254740992.0) && (value == qint64(value))) {
+        append_tns(tns, QByteArray::number(qint64(value)), '#');
+    }
+    else {
+        append_tns(tns, QByteArray::number(value, 'g', 17), '^');
+    }
+}
+
+
+#if QT_VERSION >= 0x050000
+
+/**
+ * builds a QJsonValue tree from the events of walk()
+ */
+class JsonValueBuilder : public Handler {
+public:
+    QJsonValue value() const
+    {
+        return m_value;
+    }
+
+    bool null()
+    {
+        return add(QJsonValue(QJsonValue::Null));
+    }
+
+    bool boolean(bool value)
+    {
+        return add(QJsonValue(value));
+    }
+
+    bool integer(const char *data, int size)
+    {
+        QByteArray text = QByteArray::fromRawData(data, size);
+        bool ok;
+        qint64 value = text.toLongLong(&ok);
+        if (ok) {
+            return add(QJsonValue(double(value)));
+        }
+        quint64 unsigned_value = text.toULongLong(&ok);
+        return ok && add(QJsonValue(double(unsigned_value)));
+    }
+
+    bool floating(const char *data, int size)
+    {
+        bool ok;
+        double value = QByteArray::fromRawData(data, size).toDouble(&ok);
+        return ok && add(QJsonValue(value));
+    }
+
+    bool string(const char *data, int size)
+    {
+        return add(QJsonValue(QString::fromUtf8(data, size)));
+    }
+
+    bool beginList()
+    {
+        m_arrays.append(QJsonArray());
+        m_types.append(']');
+        return true;
+    }
+
+    bool endList()
+    {
+        m_types.chop(1);
+        return add(m_arrays.takeLast());
+    }
+
+    bool beginMap()
+    {
+        m_objects.append(QJsonObject());
+        m_keys.append(QString());
+        m_types.append('}');
+        return true;
+    }
+
+    bool key(const char *data, int size)
+    {
+        m_keys.last() = QString::fromUtf8(data, size);
+        return true;
+    }
+
+    bool endMap()
+    {
+        m_types.chop(1);
+        m_keys.removeLast();
+        return add(m_objects.takeLast());
+    }
+
+private:
+    bool add(const QJsonValue &value)
+    {
+        if (m_types.isEmpty()) {
+            m_value = value;
+        }
+        else if (m_types.at(m_types.size() - 1) == ']') {
+            m_arrays.last().append(value);
+        }
+        else {
+            m_objects.last().insert(m_keys.last(), value);
+        }
+        return true;
+    }
+
+    QList<QJsonArray> m_arrays;
+    QList<QJsonObject> m_objects;
+    QList<QString> m_keys;
+    QByteArray m_types;
+    QJsonValue m_value;
+};
+
+
+QJsonValue
+QTNetString::parseJsonValue(const QByteArray &tnetstring, bool &ok)
+{
+    JsonValueBuilder builder;
+    qint64 tns_end_pos;
+
+    walk(tnetstring.constData(), tnetstring.size(), 0, tns_end_pos, builder, ok);
+    if (!ok) {
+        return QJsonValue(QJsonValue::Undefined);
+    }
+    return builder.value();
+}
+
+
+static void
+dump_json_value(const QJsonValue &value, QByteArray &tns, bool &ok)
+{
+    switch (value.type()) {
+        case QJsonValue::Null:
+            append_tns(tns, QByteArray(), '~');
+            break;
+        case QJsonValue::Bool:
+            append_tns(tns, value.toBool() ? "true" : "false", '!');
+            break;
+        case QJsonValue::Double:
+            append_number(tns, value.toDouble());
+            break;
+        case QJsonValue::String:
+            append_tns(tns, value.toString().toUtf8(), ',');
+            break;
+        case QJsonValue::Array: {
+            QByteArray payload;
+            QJsonArray array = value.toArray();
+            for (QJsonArray::const_iterator iter = array.constBegin();
+                        ok && (iter != array.constEnd()); ++iter) {
+                dump_json_value(*iter, payload, ok);
+            }
+            append_tns(tns, payload, ']');
+            break;
+        }
+        case QJsonValue::Object: {
+            QByteArray payload;
+            QJsonObject object = value.toObject();
+            for (QJsonObject::const_iterator iter = object.constBegin();
+                        ok && (iter != object.constEnd()); ++iter) {
+                append_tns(payload, iter.key().toUtf8(), ',');
+                dump_json_value(iter.value(), payload, ok);
+            }
+            append_tns(tns, payload, '}');
+            break;
+        }
+        default:
+            qDebug() << "can not dump undefined json value";
+            ok = false;
+    }
+}
+
+
+QByteArray
+QTNetString::dumpJsonValue(const QJsonValue &value, bool &ok)
+{
+    QByteArray tns;
+
+    ok = true;
+    dump_json_value(value, tns, ok);
+    if (!ok) {
+        tns.clear();
+    }
+    return tns;
+}
+
+#endif
+
+
+#if QT_VERSION >= 0x050C00
+
+/**
+ * builds a QCborValue tree from the events of walk()
+ */
+class CborValueBuilder : public Handler {
+public:
+    QCborValue value() const
+    {
+        return m_value;
+    }
+
+    bool null()
+    {
+        return add(QCborValue(nullptr));
+    }
+
+    bool boolean(bool value)
+    {
+        return add(QCborValue(value));
+    }
+
+    bool integer(const char *data, int size)
+    {
+        QByteArray text = QByteArray::fromRawData(data, size);
+        bool ok;
+        qint64 value = text.toLongLong(&ok);
+        if (ok) {
+            return add(QCborValue(value));
+        }
+
+        // QCborValue only holds qint64 integers, larger ones are
+        // kept as doubles
+        quint64 unsigned_value = text.toULongLong(&ok);
+        return ok && add(QCborValue(double(unsigned_value)));
+    }
+
+    bool floating(const char *data, int size)
+    {
+        bool ok;
+        double value = QByteArray::fromRawData(data, size).toDouble(&ok);
+        return ok && add(QCborValue(value));
+    }
+
+    bool string(const char *data, int size)
+    {
+        return add(string_value(data, size));
+    }
+
+    bool beginList()
+    {
+        m_arrays.append(QCborArray());
+        m_types.append(']');
+        return true;
+    }
+
+    bool endList()
+    {
+        m_types.chop(1);
+        return add(m_arrays.takeLast());
+    }
+
+    bool beginMap()
+    {
+        m_maps.append(QCborMap());
+        m_keys.append(QCborValue());
+        m_types.append('}');
+        return true;
+    }
+
+    bool key(const char *data, int size)
+    {
+        m_keys.last() = string_value(data, size);
+        return true;
+    }
+
+    bool endMap()
+    {
+        m_types.chop(1);
+        m_keys.removeLast();
+        return add(m_maps.takeLast());
+    }
+
+private:
+    /**
+     * tns strings are bytes, only valid UTF-8 becomes a text string
+     */
+    static QCborValue string_value(const char *data, int size)
+    {
+        if (isUtf8(data, size)) {
+            return QCborValue(QString::fromUtf8(data, size));
+        }
+        return QCborValue(QByteArray(data, size));
+    }
+
+    bool add(const QCborValue &value)
+    {
+        if (m_types.isEmpty()) {
+            m_value = value;
+        }
+        else if (m_types.at(m_types.size() - 1) == ']') {
+            m_arrays.last().append(value);
+        }
+        else {
+            m_maps.last().insert(m_keys.last(), value);
+        }
+        return true;
+    }
+
+    QList<QCborArray> m_arrays;
+    QList<QCborMap> m_maps;
+    QList<QCborValue> m_keys;
+    QByteArray m_types;
+    QCborValue m_value;
+};
+
+
+QCborValue
+QTNetString::parseCborValue(const QByteArray &tnetstring, bool &ok)
+{
+    CborValueBuilder builder;
+    qint64 tns_end_pos;
+
+    walk(tnetstring.constData(), tnetstring.size(), 0, tns_end_pos, builder, ok);
+    if (!ok) {
+        return QCborValue(QCborValue::Invalid);
+    }
+    return builder.value();
+}
+
+
+static void
+dump_cbor_value(const QCborValue &value, QByteArray &tns, bool &ok)
+{
+    switch (value.type()) {
+        case QCborValue::Null:
+        case QCborValue::Undefined:
+            append_tns(tns, QByteArray(), '~');
+            break;
+        case QCborValue::False:
+            append_tns(tns, "false", '!');
+            break;
+        case QCborValue::True:
+            append_tns(tns, "true", '!');
+            break;
+        case QCborValue::Integer:
+            append_tns(tns, QByteArray::number(value.toInteger()), '#');
+            break;
+        case QCborValue::Double:
+            append_tns(tns, QByteArray::number(value.toDouble(), 'g', 17), '^');
+            break;
+        case QCborValue::ByteArray:
+            append_tns(tns, value.toByteArray(), ',');
+            break;
+        case QCborValue::String:
+            append_tns(tns, value.toString().toUtf8(), ',');
+            break;
+        case QCborValue::Tag:
+            dump_cbor_value(value.taggedValue(), tns, ok);
+            break;
+        case QCborValue::Array: {
+            QByteArray payload;
+            QCborArray array = value.toArray();
+            for (QCborArray::ConstIterator iter = array.constBegin();
+                        ok && (iter != array.constEnd()); ++iter) {
+                dump_cbor_value(*iter, payload, ok);
+            }
+            append_tns(tns, payload, ']');
+            break;
+        }
+        case QCborValue::Map: {
+            QByteArray payload;
+            QCborMap map = value.toMap();
+            for (QCborMap::ConstIterator iter = map.constBegin();
+                        ok && (iter != map.constEnd()); ++iter) {
+                QCborValue key = iter.key();
+                if (key.isString()) {
+                    append_tns(payload, key.toString().toUtf8(), ',');
+                }
+                else if (key.isByteArray()) {
+                    append_tns(payload, key.toByteArray(), ',');
+                }
+                else {
+                    qDebug() << "tns map keys are only allowed to be strings";
+                    ok = false;
+                    break;
+                }
+                dump_cbor_value(iter.value(), payload, ok);
+            }
+            append_tns(tns, payload, '}');
+            break;
+        }
+        default:
+            qDebug() << "unsupported cbor value type: " << int(value.type());
+            ok = false;
+    }
+}
+
+
+QByteArray
+QTNetString::dumpCborValue(const QCborValue &value, bool &ok)
+{
+    QByteArray tns;
+
+    ok = true;
+    dump_cbor_value(value, tns, ok);
+    if (!ok) {
+        tns.clear();
+    }
+    return tns;
+}
+
+#endif
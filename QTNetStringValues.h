@@ -0,0 +1,74 @@
+#ifndef __qtnetstring_values_h__
+#define __qtnetstring_values_h__
+
+
+#include "QByteArray"
+#include "QtGlobal"
+
+#if QT_VERSION >= 0x050000
+#include "QJsonValue"
+#endif
+
+#if QT_VERSION >= 0x050C00
+#include "QCborValue"
+#endif
+
+
+/**
+ * Parse TNetStrings directly into the value types of Qt 5 and dump
+ * them without going through QVariant. Only available when building
+ * against a Qt version which has these types.
+ */
+namespace QTNetString {
+
+#if QT_VERSION >= 0x050000
+    /**
+     * Parse a TNetString into a QJsonValue tree.
+     *
+     * Strings are expected to be UTF-8. Integers become doubles, like
+     * all numbers in JSON.
+     *
+     * returns QJsonValue::Undefined on error and sets ok to false.
+     */
+    QJsonValue parseJsonValue(const QByteArray &tnetstring, bool &ok);
+
+    /**
+     * Dump a QJsonValue tree into a TNetString.
+     *
+     * Doubles without a fractional part which can be represented
+     * exactly are dumped as integers.
+     *
+     * sets ok to false in case of an error and returns
+     * an empty QByteArray.
+     */
+    QByteArray dumpJsonValue(const QJsonValue &value, bool &ok);
+#endif
+
+#if QT_VERSION >= 0x050C00
+    /**
+     * Parse a TNetString into a QCborValue tree.
+     *
+     * Strings and map keys which are valid UTF-8 become text
+     * strings, all others byte strings. Integers which do not fit
+     * into a qint64 become doubles.
+     *
+     * returns QCborValue::Invalid on error and sets ok to false.
+     */
+    QCborValue parseCborValue(const QByteArray &tnetstring, bool &ok);
+
+    /**
+     * Dump a QCborValue tree into a TNetString.
+     *
+     * Tags are dropped, undefined becomes null. Map keys have to be
+     * text or byte strings.
+     *
+     * sets ok to false in case of an error and returns
+     * an empty QByteArray.
+     */
+    QByteArray dumpCborValue(const QCborValue &value, bool &ok);
+#endif
+
+}
+
+
+#endif
@@ -0,0 +1,61 @@
+#-------------------------------------------------
+#
+# Sources of the library, for projects which want to
+# build all components instead of picking single files
+#
+#-------------------------------------------------
+
+QT       += core
+greaterThan(QT_MAJOR_VERSION, 4): QT += concurrent
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/QTNetString.cpp \
+    $$PWD/QTNetStringSharedRing.cpp \
+    $$PWD/QTNetStringFrameQueue.cpp \
+    $$PWD/QTNetStringPipeline.cpp \
+    $$PWD/QTNetStringAsync.cpp \
+    $$PWD/QTNetStringDecoder.cpp \
+    $$PWD/QTNetStringSax.cpp \
+    $$PWD/QTNetStringJson.cpp \
+    $$PWD/QTNetStringCbor.cpp \
+    $$PWD/QTNetStringMsgPack.cpp \
+    $$PWD/QTNetStringValues.cpp \
+    $$PWD/QTNetStringParseCache.cpp \
+    $$PWD/QTNetStringDocument.cpp \
+    $$PWD/QTNetStringDelta.cpp \
+    $$PWD/QTNetStringIndex.cpp \
+    $$PWD/QTNetStringColumns.cpp \
+    $$PWD/QTNetStringFilter.cpp \
+    $$PWD/QTNetStringSchema.cpp \
+    $$PWD/QTNetStringDictionary.cpp \
+    $$PWD/QTNetStringArchive.cpp \
+    $$PWD/QTNetStringChecksum.cpp \
+    $$PWD/QTNetStringFileReader.cpp \
+    $$PWD/QTNetStringEncoder.cpp
+
+HEADERS += \
+    $$PWD/QTNetString.h \
+    $$PWD/QTNetStringSharedRing.h \
+    $$PWD/QTNetStringFrameQueue.h \
+    $$PWD/QTNetStringPipeline.h \
+    $$PWD/QTNetStringAsync.h \
+    $$PWD/QTNetStringDecoder.h \
+    $$PWD/QTNetStringSax.h \
+    $$PWD/QTNetStringJson.h \
+    $$PWD/QTNetStringCbor.h \
+    $$PWD/QTNetStringMsgPack.h \
+    $$PWD/QTNetStringValues.h \
+    $$PWD/QTNetStringParseCache.h \
+    $$PWD/QTNetStringDocument.h \
+    $$PWD/QTNetStringDelta.h \
+    $$PWD/QTNetStringIndex.h \
+    $$PWD/QTNetStringColumns.h \
+    $$PWD/QTNetStringFilter.h \
+    $$PWD/QTNetStringSchema.h \
+    $$PWD/QTNetStringDictionary.h \
+    $$PWD/QTNetStringArchive.h \
+    $$PWD/QTNetStringChecksum.h \
+    $$PWD/QTNetStringFileReader.h \
+    $$PWD/QTNetStringEncoder.h
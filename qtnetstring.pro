@@ -15,8 +15,6 @@ CONFIG   -= app_bundle
 TEMPLATE = app
 
 
-SOURCES += main.cpp \
-    QTNetString.cpp
+SOURCES += main.cpp
 
-HEADERS += \
-    QTNetString.h
+include(qtnetstring.pri)
@@ -0,0 +1,490 @@
+#include <QtCore/QCoreApplication>
+#include <QStringList>
+#include <QByteArray>
+#include <QVector>
+#include <QFile>
+#include <QTextStream>
+
+#include <stdio.h>
+
+#include "QTNetString.h"
+#include "QTNetStringJson.h"
+#include "QTNetStringFilter.h"
+#include "QTNetStringSchema.h"
+
+
+using namespace QTNetString;
+
+
+static const char USAGE[] =
+    "usage: tns <command> [arguments] <file>...\n"
+    "\n"
+    "commands:\n"
+    "  cat <file>...               write every record on its own line\n"
+    "  validate <file>...          check that the files only contain valid records\n"
+    "  grep [-c] <expr>... <file>  write the records matching all expressions\n"
+    "  stats <file>...             number and sizes of the records\n"
+    "  schema <file>...            paths, types, size percentiles and depth\n"
+    "  to-json <file>...           convert the records to JSON lines\n"
+    "\n"
+    "grep expressions, paths are map keys and list indexes separated by '.':\n"
+    "  path=value                  number equal to value if it is numeric,\n"
+    "                              string equal to value otherwise\n"
+    "  path=min..max               number between min and max\n"
+    "  path^=prefix                string starting with prefix\n"
+    "  path?                       any value at path\n";
+
+
+static QTextStream err(stderr);
+
+
+/**
+ * a file mapped into memory, records are read from the mapping
+ * without copying them.
+ */
+class MappedFile {
+public:
+    MappedFile(const QString &file_name)
+        : m_file(file_name), m_data(0)
+    {
+    }
+
+    ~MappedFile()
+    {
+        if (m_data) {
+            m_file.unmap(m_data);
+        }
+    }
+
+    bool open()
+    {
+        if (!m_file.open(QIODevice::ReadOnly)) {
+            err << m_file.fileName() << ": " << m_file.errorString() << endl;
+            return false;
+        }
+        if (m_file.size() == 0) {
+            return true;
+        }
+
+        m_data = m_file.map(0, m_file.size());
+        if (!m_data) {
+            err << m_file.fileName() << ": " << m_file.errorString() << endl;
+            return false;
+        }
+        return true;
+    }
+
+    const char *data() const
+    {
+        return reinterpret_cast<const char *>(m_data);
+    }
+
+    qint64 size() const
+    {
+        return m_data ? m_file.size() : 0;
+    }
+
+    QString fileName() const
+    {
+        return m_file.fileName();
+    }
+
+private:
+    QFile m_file;
+    uchar *m_data;
+
+    Q_DISABLE_COPY(MappedFile)
+};
+
+
+/**
+ * check the payload of every element, framing alone accepts scalars
+ * like 5:abcde# or 4:true!
+ */
+static bool
+valid_element(const QByteArray &record, const Element &element)
+{
+    QByteArray payload = QByteArray::fromRawData(record.constData() + element.pl_start,
+                element.pl_end - element.pl_start);
+    bool ok = true;
+
+    switch (element.type) {
+        case '~':
+            return payload.isEmpty();
+        case '!':
+            return (payload == "true") || (payload == "false");
+        case '#':
+            payload.toLongLong(&ok);
+            if (!ok) {
+                payload.toULongLong(&ok);
+            }
+            return ok;
+        case '^':
+            payload.toDouble(&ok);
+            return ok;
+        case ',':
+            return true;
+        case ']': {
+            Element child;
+            int pos = element.pl_start;
+            while (ok && (pos < element.pl_end)
+                        && elementAt(record, pos, element.pl_end, child, ok)) {
+                ok = valid_element(record, child);
+                pos = child.end;
+            }
+            return ok;
+        }
+        case '}': {
+            Element key;
+            Element child;
+            int pos = element.pl_start;
+            while (ok && (pos < element.pl_end)
+                        && elementAt(record, pos, element.pl_end, key, ok)
+                        && elementAt(record, key.end, element.pl_end, child, ok)) {
+                ok = (key.type == ',') && valid_element(record, child);
+                pos = child.end;
+            }
+            return ok;
+        }
+    }
+    return false;
+}
+
+
+static bool
+next_record(const MappedFile &file, qint64 pos, qint64 &tns_end_pos)
+{
+    bool ok;
+    if (!frame(file.data(), file.size(), pos, tns_end_pos, ok)) {
+        err << file.fileName() << ": " << (ok ? "incomplete" : "invalid")
+                << " record at offset " << pos << endl;
+        return false;
+    }
+    return true;
+}
+
+
+static int
+command_cat(const QStringList &args, QFile &out)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        MappedFile file(args.at(i));
+        if (!file.open()) {
+            return 1;
+        }
+
+        qint64 pos = 0;
+        while (pos < file.size()) {
+            qint64 tns_end_pos;
+            if (!next_record(file, pos, tns_end_pos)) {
+                return 1;
+            }
+            out.write(file.data() + pos, tns_end_pos - pos);
+            out.write("\n", 1);
+            pos = tns_end_pos;
+        }
+    }
+    return 0;
+}
+
+
+static int
+command_validate(const QStringList &args, QFile &out)
+{
+    int result = 0;
+
+    for (int i = 0; i < args.size(); ++i) {
+        MappedFile file(args.at(i));
+        if (!file.open()) {
+            result = 1;
+            continue;
+        }
+
+        qint64 pos = 0;
+        qint64 records = 0;
+        bool ok = true;
+        while (ok && (pos < file.size())) {
+            qint64 tns_end_pos;
+            bool complete = frame(file.data(), file.size(), pos, tns_end_pos, ok);
+            ok = complete && ((tns_end_pos - pos) <= 0x7fffffff);
+            if (ok) {
+                Element element;
+                QByteArray record = QByteArray::fromRawData(file.data() + pos,
+                            int(tns_end_pos - pos));
+                ok = elementAt(record, 0, record.size(), element, ok)
+                            && valid_element(record, element);
+            }
+            if (!ok) {
+                err << file.fileName() << ": invalid record at offset " << pos << endl;
+                result = 1;
+                break;
+            }
+            pos = tns_end_pos;
+            ++records;
+        }
+
+        if (ok) {
+            QTextStream(&out) << file.fileName() << ": " << records << " records ok" << endl;
+        }
+    }
+    return result;
+}
+
+
+static bool
+add_expression(Filter &filter, const QString &expression)
+{
+    // values may end with '?', so it only means exists without '='
+    int equal_pos = expression.indexOf('=');
+    if ((equal_pos < 0) && (expression.size() > 1) && expression.endsWith('?')) {
+        filter.addExists(expression.left(expression.size() - 1).split('.'));
+        return true;
+    }
+    if (equal_pos <= 0) {
+        err << "invalid expression: " << expression << endl;
+        return false;
+    }
+
+    QStringList path = expression.left(equal_pos).split('.');
+    QString value = expression.mid(equal_pos + 1);
+
+    if (path.last().endsWith('^')) {
+        path.last().chop(1);
+        filter.addPrefix(path, value.toUtf8());
+        return true;
+    }
+
+    bool is_number;
+    double number = value.toDouble(&is_number);
+    if (is_number) {
+        filter.addRange(path, number, number);
+        return true;
+    }
+
+    int range_pos = value.indexOf("..");
+    if (range_pos >= 0) {
+        bool min_ok;
+        bool max_ok;
+        double min = value.left(range_pos).toDouble(&min_ok);
+        double max = value.mid(range_pos + 2).toDouble(&max_ok);
+        if (min_ok && max_ok) {
+            filter.addRange(path, min, max);
+            return true;
+        }
+    }
+
+    bool ok;
+    filter.addEquals(path, QVariant(value.toUtf8()), ok);
+    return ok;
+}
+
+
+static int
+command_grep(QStringList args, QFile &out)
+{
+    bool count_only = !args.isEmpty() && (args.first() == "-c");
+    if (count_only) {
+        args.removeFirst();
+    }
+    if (args.size() < 2) {
+        err << USAGE;
+        return 2;
+    }
+
+    Filter filter;
+    QString file_name = args.takeLast();
+    for (int i = 0; i < args.size(); ++i) {
+        if (!add_expression(filter, args.at(i))) {
+            return 2;
+        }
+    }
+
+    MappedFile file(file_name);
+    if (!file.open()) {
+        return 1;
+    }
+
+    bool ok;
+    QVector<qint64> positions = filter.scan(file.data(), file.size(), ok);
+
+    if (count_only) {
+        QTextStream(&out) << positions.size() << endl;
+    }
+    else {
+        for (int i = 0; i < positions.size(); ++i) {
+            qint64 tns_end_pos;
+            next_record(file, positions.at(i), tns_end_pos);
+            out.write(file.data() + positions.at(i), tns_end_pos - positions.at(i));
+            out.write("\n", 1);
+        }
+    }
+
+    if (!ok) {
+        err << file.fileName() << ": stopped at an invalid record" << endl;
+        return 1;
+    }
+    return positions.isEmpty() ? 1 : 0;
+}
+
+
+static int
+command_stats(const QStringList &args, QFile &out)
+{
+    QTextStream stream(&out);
+
+    for (int i = 0; i < args.size(); ++i) {
+        MappedFile file(args.at(i));
+        if (!file.open()) {
+            return 1;
+        }
+
+        qint64 records = 0;
+        qint64 min_size = 0;
+        qint64 max_size = 0;
+        qint64 types[256] = { 0 };
+        qint64 pos = 0;
+
+        while (pos < file.size()) {
+            qint64 tns_end_pos;
+            if (!next_record(file, pos, tns_end_pos)) {
+                return 1;
+            }
+
+            qint64 size = tns_end_pos - pos;
+            min_size = (records == 0) ? size : qMin(min_size, size);
+            max_size = qMax(max_size, size);
+            ++types[uchar(file.data()[tns_end_pos - 1])];
+            ++records;
+            pos = tns_end_pos;
+        }
+
+        stream << file.fileName() << ":" << endl
+                << "  bytes:   " << file.size() << endl
+                << "  records: " << records << endl;
+        if (records > 0) {
+            stream << "  size:    min " << min_size << ", avg " << (file.size() / records)
+                    << ", max " << max_size << endl;
+        }
+
+        const char type_chars[] = "}],#^!~";
+        const char *type_names[] = { "map", "list", "string", "integer", "float",
+                    "boolean", "null" };
+        for (int t = 0; type_chars[t]; ++t) {
+            if (types[uchar(type_chars[t])] > 0) {
+                stream << "  " << type_names[t] << ": " << types[uchar(type_chars[t])] << endl;
+            }
+        }
+    }
+    return 0;
+}
+
+
+static int
+command_schema(const QStringList &args, QFile &out)
+{
+    QTextStream stream(&out);
+    const char *type_names[] = { "null", "boolean", "integer", "float", "string", "list",
+                "map" };
+
+    for (int i = 0; i < args.size(); ++i) {
+        MappedFile file(args.at(i));
+        if (!file.open()) {
+            return 1;
+        }
+
+        bool ok;
+        Statistics statistics = inferStatistics(file.data(), file.size(), ok);
+        if (!ok) {
+            err << file.fileName() << ": stopped at an invalid record" << endl;
+            return 1;
+        }
+
+        stream << file.fileName() << ":" << endl
+                << "  records:   " << statistics.records() << endl
+                << "  size:      p50 " << statistics.recordSize(50)
+                << ", p90 " << statistics.recordSize(90)
+                << ", p99 " << statistics.recordSize(99)
+                << ", max " << statistics.recordSize(100) << endl
+                << "  max depth: " << statistics.maxDepth() << endl;
+        if (statistics.droppedValues() > 0) {
+            stream << "  values at uncounted paths: " << statistics.droppedValues() << endl;
+        }
+
+        QMap<QByteArray, Statistics::PathStatistics> paths = statistics.paths();
+        QMap<QByteArray, Statistics::PathStatistics>::const_iterator iter;
+        for (iter = paths.constBegin(); iter != paths.constEnd(); ++iter) {
+            const Statistics::PathStatistics &path = iter.value();
+            stream << "  " << (iter.key().isEmpty() ? QByteArray("(root)") : iter.key())
+                    << ": " << path.count;
+            for (int t = 0; t < Statistics::ValueTypeCount; ++t) {
+                if (path.types[t] > 0) {
+                    stream << ", " << type_names[t] << " " << path.types[t];
+                }
+            }
+            if (path.max_size > 0) {
+                stream << ", max size " << path.max_size;
+            }
+            stream << endl;
+        }
+    }
+    return 0;
+}
+
+
+static int
+command_to_json(const QStringList &args, QFile &out)
+{
+    for (int i = 0; i < args.size(); ++i) {
+        MappedFile file(args.at(i));
+        if (!file.open()) {
+            return 1;
+        }
+
+        bool ok;
+        toJson(file.data(), file.size(), &out, ok);
+        if (!ok) {
+            err << file.fileName() << ": stopped at an invalid record" << endl;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QStringList args = a.arguments();
+    args.removeFirst();
+    if (args.size() < 2) {
+        err << USAGE;
+        return 2;
+    }
+
+    QFile out;
+    out.open(stdout, QIODevice::WriteOnly);
+
+    QString command = args.takeFirst();
+    if (command == "cat") {
+        return command_cat(args, out);
+    }
+    if (command == "validate") {
+        return command_validate(args, out);
+    }
+    if (command == "grep") {
+        return command_grep(args, out);
+    }
+    if (command == "stats") {
+        return command_stats(args, out);
+    }
+    if (command == "schema") {
+        return command_schema(args, out);
+    }
+    if (command == "to-json") {
+        return command_to_json(args, out);
+    }
+
+    err << USAGE;
+    return 2;
+}
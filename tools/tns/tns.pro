@@ -0,0 +1,20 @@
+#-------------------------------------------------
+#
+# tns command line tool
+#
+#-------------------------------------------------
+
+QT       += core
+
+QT       -= gui
+
+TARGET = tns
+CONFIG   += console
+CONFIG   -= app_bundle
+
+TEMPLATE = app
+
+
+SOURCES += main.cpp
+
+include(../../qtnetstring.pri)